@@ -0,0 +1,182 @@
+#ifndef ALPHABET_H__
+#define ALPHABET_H__
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * Alphabets describe how a BasicTrie splits keys into symbols. Every alphabet
+ * provides
+ *
+ *   Symbol     - the type stored on each trie edge
+ *   String     - the key type produced by the trie
+ *   StringView - the key type accepted by the trie
+ *   Decode     - reads the symbol at `pos` and advances `pos`, returning false
+ *                if the input is not a string over the alphabet
+ *   Encode     - appends a symbol to a key
+ *
+ * Dense alphabets additionally define `kSize`; their symbols are slots in
+ * [0, kSize) so the trie can use direct-indexed child arrays.
+ */
+
+/**
+ * Arbitrary bytes, including NUL.
+ */
+struct ByteAlphabet {
+  using Symbol = unsigned char;
+  using String = std::string;
+  using StringView = std::string_view;
+
+  static bool Decode(StringView s, std::size_t& pos, Symbol& out) noexcept {
+    out = static_cast<Symbol>(s[pos++]);
+    return true;
+  }
+  static void Encode(Symbol c, String& out) {
+    out.push_back(static_cast<char>(c));
+  }
+};  // struct ByteAlphabet
+
+/**
+ * Unicode code points of UTF-8 encoded strings. Malformed sequences, overlong
+ * encodings and surrogates are rejected.
+ */
+struct Utf8Alphabet {
+  using Symbol = char32_t;
+  using String = std::string;
+  using StringView = std::string_view;
+
+  static bool Decode(StringView s, std::size_t& pos, Symbol& out) noexcept {
+    const auto lead = static_cast<unsigned char>(s[pos]);
+    std::size_t len;
+    char32_t min;
+    if (lead < 0x80) {
+      out = lead;
+      ++pos;
+      return true;
+    } else if ((lead & 0xe0) == 0xc0) {
+      len = 2;
+      min = 0x80;
+      out = lead & 0x1f;
+    } else if ((lead & 0xf0) == 0xe0) {
+      len = 3;
+      min = 0x800;
+      out = lead & 0x0f;
+    } else if ((lead & 0xf8) == 0xf0) {
+      len = 4;
+      min = 0x10000;
+      out = lead & 0x07;
+    } else {
+      return false;
+    }
+    if (s.size() - pos < len) return false;
+    for (std::size_t i = 1; i < len; ++i) {
+      const auto c = static_cast<unsigned char>(s[pos + i]);
+      if ((c & 0xc0) != 0x80) return false;
+      out = (out << 6) | (c & 0x3f);
+    }
+    if (out < min || out > 0x10ffff || (out >= 0xd800 && out <= 0xdfff))
+      return false;
+    pos += len;
+    return true;
+  }
+  static void Encode(Symbol c, String& out) {
+    if (c < 0x80) {
+      out.push_back(static_cast<char>(c));
+    } else if (c < 0x800) {
+      out.push_back(static_cast<char>(0xc0 | (c >> 6)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+    } else if (c < 0x10000) {
+      out.push_back(static_cast<char>(0xe0 | (c >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+    } else {
+      out.push_back(static_cast<char>(0xf0 | (c >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+    }
+  }
+};  // struct Utf8Alphabet
+
+/**
+ * UTF-16 code units.
+ */
+struct Utf16Alphabet {
+  using Symbol = char16_t;
+  using String = std::u16string;
+  using StringView = std::u16string_view;
+
+  static bool Decode(StringView s, std::size_t& pos, Symbol& out) noexcept {
+    out = s[pos++];
+    return true;
+  }
+  static void Encode(Symbol c, String& out) { out.push_back(c); }
+};  // struct Utf16Alphabet
+
+/**
+ * Character to slot mapping of a DenseAlphabet and its inverse.
+ */
+template <char... Cs>
+struct DenseAlphabetTable {
+  std::uint8_t slot[256];
+  char chars[sizeof...(Cs) + 1];
+};
+
+template <char... Cs>
+constexpr DenseAlphabetTable<Cs...> MakeDenseAlphabetTable() {
+  DenseAlphabetTable<Cs...> t{};
+  const char cs[] = {Cs..., '\0'};
+  for (std::size_t i = 0; i < 256; ++i) t.slot[i] = sizeof...(Cs);
+  for (std::size_t i = 0; i < sizeof...(Cs); ++i) {
+    t.slot[static_cast<unsigned char>(cs[i])] = static_cast<std::uint8_t>(i);
+    t.chars[i] = cs[i];
+  }
+  return t;
+}
+
+/**
+ * A small alphabet of the given characters, remapped to the dense slots
+ * [0, sizeof...(Cs)) in the order listed. Character to slot lookup is a single
+ * access to a table built at compile time.
+ */
+template <char... Cs>
+struct DenseAlphabet {
+  using Symbol = std::uint8_t;
+  using String = std::string;
+  using StringView = std::string_view;
+
+  static constexpr std::size_t kSize = sizeof...(Cs);
+  static_assert(kSize > 0 && kSize < 256,
+                "DenseAlphabet needs between 1 and 255 characters");
+
+  static bool Decode(StringView s, std::size_t& pos, Symbol& out) noexcept {
+    const auto slot = kTable.slot[static_cast<unsigned char>(s[pos++])];
+    out = static_cast<Symbol>(slot);
+    return slot != kInvalid;
+  }
+  static void Encode(Symbol c, String& out) { out.push_back(kTable.chars[c]); }
+
+  /**
+   * Maps a character to its slot, or returns kInvalid.
+   */
+  static constexpr std::size_t Slot(char c) noexcept {
+    return kTable.slot[static_cast<unsigned char>(c)];
+  }
+
+  /**
+   * Slot of characters outside the alphabet. It directly follows the valid
+   * slots, so tables with kSize + 1 columns can be indexed without a check.
+   */
+  static constexpr std::size_t kInvalid = kSize;
+
+ private:
+  static constexpr DenseAlphabetTable<Cs...> kTable =
+      MakeDenseAlphabetTable<Cs...>();
+};  // struct DenseAlphabet
+
+using DnaAlphabet = DenseAlphabet<'A', 'C', 'G', 'T'>;
+using HexAlphabet = DenseAlphabet<'0', '1', '2', '3', '4', '5', '6', '7', '8',
+                                  '9', 'a', 'b', 'c', 'd', 'e', 'f'>;
+
+#endif  // ALPHABET_H__
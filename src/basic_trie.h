@@ -0,0 +1,212 @@
+#ifndef BASIC_TRIE_H__
+#define BASIC_TRIE_H__
+#include <cstddef>
+#include <memory>
+#include <stack>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "alphabet.h"
+#include "dense_trie.h"
+
+/**
+ * Prefix trie over the symbols of an alphabet (see alphabet.h), e.g. bytes,
+ * UTF-8 code points or UTF-16 code units. Children are kept in hash maps keyed
+ * by symbol; dense alphabets such as DNA or hex digits are laid out as a
+ * DenseTrie instead, see the specialisation below.
+ */
+template <typename Alphabet, typename = void>
+class BasicTrie {
+ public:
+  using Symbol = typename Alphabet::Symbol;
+  using String = typename Alphabet::String;
+  using StringView = typename Alphabet::StringView;
+
+  BasicTrie() : root_(std::make_unique<Node>()), size_(0), node_count_(1) {}
+
+  /**
+   * Inserts the string into the trie. This method is idempotent. Returns false
+   * if the string was empty, already in the trie or not over the alphabet, in
+   * which case the trie is not modified.
+   */
+  bool Insert(StringView s) {
+    std::vector<Symbol> symbols;
+    if (s.empty() || !Decode(s, symbols)) return false;
+
+    Node* runner = root_.get();
+    for (const auto c : symbols) {
+      auto next = runner->Children().FindOrCreate(c);
+      if (next.second) ++node_count_;
+      runner = next.first;
+    }
+    if (runner->IsTerminal()) return false;
+    runner->SetTerminal(true);
+    ++size_;
+    return true;
+  }
+
+  /**
+   * Check if trie contains the prefix.
+   */
+  bool Contains(StringView s) const noexcept {
+    const Node* runner = root_.get();
+    std::size_t pos = 0;
+    Symbol c;
+    while (pos < s.size()) {
+      if (!Alphabet::Decode(s, pos, c)) return false;
+      runner = runner->Children().Find(c);
+      if (runner == nullptr) return false;
+    }
+    return true;
+  }
+
+  /**
+   * Removes the string from the trie, pruning nodes which no longer lead to
+   * any string. Returns false if the string was not in the trie.
+   */
+  bool Erase(StringView s) {
+    std::vector<Symbol> symbols;
+    if (!Decode(s, symbols)) return false;
+
+    std::vector<Node*> path{root_.get()};
+    for (const auto c : symbols) {
+      Node* next = path.back()->Children().Find(c);
+      if (next == nullptr) return false;
+      path.push_back(next);
+    }
+    if (!path.back()->IsTerminal()) return false;
+    path.back()->SetTerminal(false);
+    --size_;
+
+    while (path.size() > 1 && !path.back()->IsTerminal() &&
+           path.back()->Children().Empty()) {
+      path.pop_back();
+      path.back()->Children().Remove(symbols[path.size() - 1]);
+      --node_count_;
+    }
+    return true;
+  }
+
+  /**
+   * Number of strings in the trie.
+   */
+  std::size_t Size() const noexcept { return size_; }
+
+  /**
+   * Number of nodes in the trie, including the root.
+   */
+  std::size_t NodeCount() const noexcept { return node_count_; }
+
+  /**
+   * Passes strings who match the given prefix into the given function callback.
+   */
+  template <typename Callable>
+  void MatchWithCallback(StringView s, const Callable& callback) const {
+    const Node* runner = root_.get();
+    std::size_t pos = 0;
+    Symbol c;
+    while (pos < s.size()) {
+      if (!Alphabet::Decode(s, pos, c)) return;
+      runner = runner->Children().Find(c);
+      if (runner == nullptr) return;
+    }
+    String buf(s);
+    if (runner->IsTerminal()) callback(buf);
+
+    // Symbols may encode to several code units, so remember the key length
+    // at each node rather than its depth
+    std::stack<std::pair<std::size_t, std::pair<Symbol, const Node*>>> nodes;
+    runner->Children().ForEach([&nodes, &s](Symbol k, const Node* n) {
+      nodes.push(std::make_pair(s.size(), std::make_pair(k, n)));
+    });
+    while (!nodes.empty()) {
+      auto tmp = nodes.top();
+      nodes.pop();
+
+      buf.resize(tmp.first);
+      Alphabet::Encode(tmp.second.first, buf);
+      if (tmp.second.second->IsTerminal()) callback(buf);
+
+      const auto length = buf.size();
+      tmp.second.second->Children().ForEach(
+          [&nodes, length](Symbol k, const Node* n) {
+            nodes.push(std::make_pair(length, std::make_pair(k, n)));
+          });
+    }
+  }
+
+ private:
+  class Node;
+
+  /**
+   * Children keyed by symbol.
+   */
+  class ChildTable {
+   public:
+    Node* Find(Symbol c) const noexcept {
+      auto it = children_.find(c);
+      return it == children_.end() ? nullptr : it->second.get();
+    }
+    std::pair<Node*, bool> FindOrCreate(Symbol c) {
+      auto& slot = children_[c];
+      const bool created = !slot;
+      if (created) slot = std::make_unique<Node>();
+      return std::make_pair(slot.get(), created);
+    }
+    void Remove(Symbol c) noexcept { children_.erase(c); }
+    bool Empty() const noexcept { return children_.empty(); }
+    template <typename F>
+    void ForEach(const F& f) const {
+      for (const auto& p : children_) f(p.first, p.second.get());
+    }
+
+   private:
+    std::unordered_map<Symbol, std::unique_ptr<Node>> children_;
+  };  // class ChildTable
+
+  class Node {
+   public:
+    Node() : terminal_(false) {}
+    Node(const Node& o) = delete;
+
+    bool IsTerminal() const noexcept { return terminal_; }
+    void SetTerminal(bool t) noexcept { terminal_ = t; }
+
+    ChildTable& Children() noexcept { return children_; }
+    const ChildTable& Children() const noexcept { return children_; }
+
+   private:
+    bool terminal_;
+    ChildTable children_;
+  };  // class Node
+
+  /**
+   * Splits the string into symbols, returning false if it is not over the
+   * alphabet.
+   */
+  static bool Decode(StringView s, std::vector<Symbol>& out) {
+    out.reserve(s.size());
+    std::size_t pos = 0;
+    Symbol c;
+    while (pos < s.size()) {
+      if (!Alphabet::Decode(s, pos, c)) return false;
+      out.push_back(c);
+    }
+    return true;
+  }
+
+  std::unique_ptr<Node> root_;
+  std::size_t size_;
+  std::size_t node_count_;
+};  // class BasicTrie
+
+/**
+ * Dense alphabets (those defining kSize) use the index-based node array of
+ * DenseTrie, which also maps characters outside the alphabet to a dead node.
+ */
+template <typename Alphabet>
+class BasicTrie<Alphabet, decltype(void(Alphabet::kSize))>
+    : public DenseTrie<Alphabet> {};
+
+#endif  // BASIC_TRIE_H__
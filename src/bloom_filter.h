@@ -0,0 +1,79 @@
+#ifndef BLOOM_FILTER_H__
+#define BLOOM_FILTER_H__
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Blocked Bloom filter over 64-bit hashes. All bits of an item fall into one
+ * 512-bit block, i.e. a single cache line, so a lookup costs one memory
+ * access. This raises the false-positive rate slightly over a classic Bloom
+ * filter of the same size.
+ */
+class BloomFilter {
+ public:
+  /**
+   * Sizes the filter for `items` items at the given false-positive rate.
+   */
+  BloomFilter(std::size_t items, double false_positive_rate) {
+    const double rate = std::min(std::max(false_positive_rate, 1e-9), 0.5);
+    const double ln2 = std::log(2.0);
+    const double bits_per_item = -std::log(rate) / (ln2 * ln2);
+    const auto bits = static_cast<std::size_t>(
+        std::ceil(bits_per_item * std::max<std::size_t>(items, 1)));
+    blocks_.resize((bits + kBlockBits - 1) / kBlockBits);
+    hashes_ = static_cast<unsigned>(
+        std::min(std::max(std::lround(bits_per_item * ln2), 1L), 16L));
+  }
+
+  void Add(std::uint64_t hash) noexcept {
+    auto& block = blocks_[BlockOf(hash)];
+    std::uint32_t a = static_cast<std::uint32_t>(hash);
+    const std::uint32_t b = static_cast<std::uint32_t>(hash >> 32) | 1;
+    for (unsigned i = 0; i < hashes_; ++i, a += b)
+      block.words[(a >> 6) & 7] |= std::uint64_t{1} << (a & 63);
+  }
+
+  bool MayContain(std::uint64_t hash) const noexcept {
+    const auto& block = blocks_[BlockOf(hash)];
+    std::uint32_t a = static_cast<std::uint32_t>(hash);
+    const std::uint32_t b = static_cast<std::uint32_t>(hash >> 32) | 1;
+    for (unsigned i = 0; i < hashes_; ++i, a += b)
+      if ((block.words[(a >> 6) & 7] & (std::uint64_t{1} << (a & 63))) == 0)
+        return false;
+    return true;
+  }
+
+  std::size_t Bits() const noexcept { return blocks_.size() * kBlockBits; }
+  unsigned Hashes() const noexcept { return hashes_; }
+
+  /**
+   * False-positive rate estimated from the fraction of bits set.
+   */
+  double EstimatedFalsePositiveRate() const noexcept {
+    std::size_t set = 0;
+    for (const auto& block : blocks_)
+      for (const auto w : block.words) set += __builtin_popcountll(w);
+    return std::pow(static_cast<double>(set) / Bits(), hashes_);
+  }
+
+ private:
+  static constexpr std::size_t kBlockBits = 512;
+
+  struct alignas(64) Block {
+    std::uint64_t words[kBlockBits / 64] = {};
+  };
+
+  std::size_t BlockOf(std::uint64_t hash) const noexcept {
+    // Remix so the block does not correlate with the bits chosen inside it
+    return static_cast<std::size_t>((hash * 0x9e3779b97f4a7c15ULL) >> 32) %
+           blocks_.size();
+  }
+
+  std::vector<Block> blocks_;
+  unsigned hashes_;
+};  // class BloomFilter
+
+#endif  // BLOOM_FILTER_H__
@@ -0,0 +1,115 @@
+#ifndef CLOCK_CACHE_H__
+#define CLOCK_CACHE_H__
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Bounded map from strings to values with CLOCK (second chance) eviction. A
+ * hit only sets the entry's reference bit; the clock hand clears bits as it
+ * sweeps and evicts the first entry found unreferenced.
+ *
+ * Entries are addressed by slot so owners can invalidate them directly. Keys
+ * are indexed by hash to avoid allocating on lookup; on a hash collision the
+ * newer key replaces the older one.
+ */
+template <typename Value>
+class ClockCache {
+ public:
+  static constexpr std::size_t kNoSlot = SIZE_MAX;
+
+  explicit ClockCache(std::size_t capacity) : slots_(capacity), hand_(0) {}
+
+  std::size_t Capacity() const noexcept { return slots_.size(); }
+
+  /**
+   * Returns the slot holding the key and marks it referenced, or kNoSlot.
+   */
+  std::size_t Find(std::string_view key) noexcept {
+    auto it = index_.find(std::hash<std::string_view>()(key));
+    if (it == index_.end() || slots_[it->second].key != key) return kNoSlot;
+    slots_[it->second].referenced = true;
+    return it->second;
+  }
+
+  Value& operator[](std::size_t slot) noexcept { return slots_[slot].value; }
+
+  /**
+   * Stores the value under the key, which must not be cached already, and
+   * returns its slot. `on_evict` is called with every value pushed out.
+   */
+  template <typename OnEvict>
+  std::size_t Insert(std::string_view key, Value value,
+                     const OnEvict& on_evict) {
+    const auto hash = std::hash<std::string_view>()(key);
+    auto it = index_.find(hash);
+    if (it != index_.end()) {
+      on_evict(slots_[it->second].value);
+      Erase(it->second);
+    }
+
+    while (slots_[hand_].used && slots_[hand_].referenced) {
+      slots_[hand_].referenced = false;
+      hand_ = (hand_ + 1) % slots_.size();
+    }
+    const auto slot = hand_;
+    hand_ = (hand_ + 1) % slots_.size();
+    if (slots_[slot].used) {
+      on_evict(slots_[slot].value);
+      Erase(slot);
+    }
+
+    auto& e = slots_[slot];
+    e.key.assign(key.data(), key.size());
+    e.hash = hash;
+    e.value = std::move(value);
+    e.used = true;
+    index_[hash] = slot;
+    return slot;
+  }
+
+  /**
+   * Drops the entry in the slot, if any.
+   */
+  void Erase(std::size_t slot) {
+    auto& e = slots_[slot];
+    if (!e.used) return;
+    index_.erase(e.hash);
+    e.key.clear();
+    e.value = Value();
+    e.used = false;
+    e.referenced = false;
+  }
+
+  /**
+   * Drops every entry, calling `on_evict` with each value.
+   */
+  template <typename OnEvict>
+  void Clear(const OnEvict& on_evict) {
+    for (std::size_t i = 0; i < slots_.size(); ++i) {
+      if (!slots_[i].used) continue;
+      on_evict(slots_[i].value);
+      Erase(i);
+    }
+  }
+
+ private:
+  struct Entry {
+    std::string key;
+    std::size_t hash = 0;
+    Value value = Value();
+    bool used = false;
+    bool referenced = false;
+  };
+
+  std::vector<Entry> slots_;
+  std::unordered_map<std::size_t, std::size_t> index_;
+  std::size_t hand_;
+};  // class ClockCache
+
+#endif  // CLOCK_CACHE_H__
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dawg.h"
+#include "prefix_trie.h"
+
+Dawg::Dawg() : states_(1), finished_(false) {}
+
+Dawg Dawg::FromTrie(const PrefixTrie& trie) {
+  // The trie enumerates its strings in lexicographic order, so they can be
+  // inserted as they are found, without holding a copy of them
+  Dawg dawg;
+  trie.MatchFrom("", "", std::numeric_limits<std::size_t>::max(),
+                 [&dawg](const std::string& s) { dawg.Insert(s); });
+  dawg.Finish();
+  return dawg;
+}
+
+bool Dawg::Insert(std::string_view s) {
+  if (finished_) return false;
+  if (s.empty() || s == previous_) return true;
+  if (s < previous_) return false;
+
+  // Only the states past the prefix shared with the previous string can be
+  // minimized, the shared ones may still gain new edges
+  std::size_t common = 0;
+  while (common < previous_.size() && s[common] == previous_[common]) ++common;
+  Minimize(common);
+
+  std::uint32_t runner = unchecked_.empty() ? 0 : unchecked_.back().second;
+  for (std::size_t i = common; i < s.size(); ++i) {
+    auto next = static_cast<std::uint32_t>(states_.size());
+    states_.emplace_back();
+    states_[runner].edges.emplace_back(s[i], next);
+    unchecked_.emplace_back(runner, next);
+    runner = next;
+  }
+  states_[runner].terminal = true;
+  previous_.assign(s.data(), s.size());
+  return true;
+}
+
+void Dawg::Finish() {
+  if (finished_) return;
+  Minimize(0);
+  finished_ = true;
+  register_.clear();
+  previous_.clear();
+
+  // Replaced states are left behind by Minimize, renumber the reachable ones
+  // into a dense vector in breadth-first order
+  std::vector<std::uint32_t> remap(states_.size(), kNone);
+  std::vector<std::uint32_t> order{0};
+  remap[0] = 0;
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    for (const auto& e : states_[order[i]].edges) {
+      if (remap[e.second] != kNone) continue;
+      remap[e.second] = static_cast<std::uint32_t>(order.size());
+      order.push_back(e.second);
+    }
+  }
+  std::vector<State> compact;
+  compact.reserve(order.size());
+  for (const auto old : order) {
+    compact.push_back(std::move(states_[old]));
+    for (auto& e : compact.back().edges) e.second = remap[e.second];
+  }
+  states_ = std::move(compact);
+}
+
+bool Dawg::Contains(std::string_view s) const noexcept {
+  std::uint32_t runner = 0;
+  for (const auto c : s) {
+    runner = Next(runner, c);
+    if (runner == kNone) return false;
+  }
+  return true;
+}
+
+std::uint32_t Dawg::Next(std::uint32_t state, char c) const noexcept {
+  const auto& edges = states_[state].edges;
+  auto it = std::lower_bound(
+      edges.begin(), edges.end(), c,
+      [](const std::pair<char, std::uint32_t>& e, char k) {
+        return static_cast<unsigned char>(e.first) <
+               static_cast<unsigned char>(k);
+      });
+  if (it == edges.end() || it->first != c) return kNone;
+  return it->second;
+}
+
+void Dawg::Minimize(std::size_t depth) {
+  while (unchecked_.size() > depth) {
+    auto parent = unchecked_.back().first;
+    auto child = unchecked_.back().second;
+    unchecked_.pop_back();
+
+    auto sig = Signature(states_[child]);
+    auto it = register_.find(sig);
+    if (it != register_.end()) {
+      states_[parent].edges.back().second = it->second;
+    } else {
+      register_.emplace(std::move(sig), child);
+    }
+  }
+}
+
+std::string Dawg::Signature(const State& state) const {
+  std::string sig;
+  sig.reserve(1 + state.edges.size() * (1 + sizeof(std::uint32_t)));
+  sig.push_back(state.terminal ? '1' : '0');
+  for (const auto& e : state.edges) {
+    sig.push_back(e.first);
+    sig.append(reinterpret_cast<const char*>(&e.second), sizeof(e.second));
+  }
+  return sig;
+}
@@ -0,0 +1,117 @@
+#ifndef DAWG_H__
+#define DAWG_H__
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class PrefixTrie;
+
+/**
+ * Directed acyclic word graph, i.e. a minimal acyclic automaton over the
+ * inserted strings. Unlike PrefixTrie, equivalent subtrees (e.g. shared
+ * suffixes such as "-ing" or ".com") are stored once.
+ *
+ * The graph is built incrementally with Daciuk's algorithm for sorted input:
+ * strings must be inserted in lexicographic order and Finish() must be called
+ * before querying.
+ */
+class Dawg {
+ public:
+  Dawg();
+
+  /**
+   * Builds a DAWG holding the same strings as the given trie.
+   */
+  static Dawg FromTrie(const PrefixTrie& trie);
+
+  /**
+   * Inserts the string into the DAWG. Strings must be inserted in
+   * lexicographic order; duplicates and empty strings are ignored. Returns
+   * false if the string is out of order or Finish() was already called.
+   */
+  bool Insert(std::string_view s);
+
+  /**
+   * Minimizes the states still pending from the last insertion and freezes
+   * the DAWG. Calling Finish() more than once has no effect.
+   */
+  void Finish();
+
+  /**
+   * Check if DAWG contains the prefix.
+   */
+  bool Contains(std::string_view s) const noexcept;
+
+  /**
+   * Number of states in the DAWG, including the start state.
+   */
+  std::size_t NodeCount() const noexcept { return states_.size(); }
+
+  /**
+   * Passes strings who match the given prefix into the given function
+   * callback, in lexicographic order.
+   */
+  template <typename Callable>
+  void MatchWithCallback(std::string_view s, const Callable& callback) const {
+    std::uint32_t runner = 0;
+    for (const auto c : s) {
+      runner = Next(runner, c);
+      if (runner == kNone) return;
+    }
+
+    // Depth-first traversal keeping one edge cursor per level, so strings are
+    // produced in edge order without materializing a stack of copies
+    std::string buf(s);
+    if (states_[runner].terminal) callback(buf);
+    std::vector<std::pair<std::uint32_t, std::size_t>> path;
+    path.emplace_back(runner, 0);
+    while (!path.empty()) {
+      auto& top = path.back();
+      const auto& edges = states_[top.first].edges;
+      if (top.second == edges.size()) {
+        path.pop_back();
+        if (!path.empty()) buf.pop_back();
+        continue;
+      }
+      const auto& e = edges[top.second++];
+      buf.push_back(e.first);
+      if (states_[e.second].terminal) callback(buf);
+      path.emplace_back(e.second, 0);
+    }
+  }
+
+ private:
+  static constexpr std::uint32_t kNone = UINT32_MAX;
+
+  struct State {
+    bool terminal = false;
+    // Outgoing edges sorted by unsigned character value
+    std::vector<std::pair<char, std::uint32_t>> edges;
+  };
+
+  std::uint32_t Next(std::uint32_t state, char c) const noexcept;
+
+  /**
+   * Replaces or registers pending states until only `depth` remain.
+   */
+  void Minimize(std::size_t depth);
+
+  /**
+   * Serializes a state's outgoing transitions for the equivalence register.
+   */
+  std::string Signature(const State& state) const;
+
+  std::vector<State> states_;
+  std::unordered_map<std::string, std::uint32_t> register_;
+  // States on the path of the last inserted string which have not yet been
+  // checked for equivalence, as (parent, child) pairs. The child is always the
+  // target of the parent's last edge since input is sorted
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> unchecked_;
+  std::string previous_;
+  bool finished_;
+};  // class Dawg
+
+#endif  // DAWG_H__
@@ -0,0 +1,199 @@
+#ifndef DENSE_TRIE_H__
+#define DENSE_TRIE_H__
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stack>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "alphabet.h"
+
+/**
+ * Prefix trie specialised at compile time for a small DenseAlphabet, e.g.
+ * DenseTrie<DnaAlphabet> for genomic keys.
+ *
+ * Nodes live in one contiguous array and refer to their children by 32-bit
+ * index instead of owning pointers, so a node over {A,C,G,T} takes 20 bytes
+ * and no separate allocation. Character to slot lookup goes through the
+ * alphabet's constexpr table, and characters outside the alphabet map to an
+ * extra slot which always leads to a dead node, so Contains walks the key
+ * without branching on missing children.
+ */
+template <typename Alphabet>
+class DenseTrie {
+ public:
+  using Symbol = typename Alphabet::Symbol;
+  using String = typename Alphabet::String;
+  using StringView = typename Alphabet::StringView;
+  using NodeIndex = std::uint32_t;
+
+  static constexpr std::size_t kSize = Alphabet::kSize;
+  static_assert(Alphabet::kInvalid == kSize,
+                "DenseTrie needs a dense alphabet");
+
+  DenseTrie() : children_(2), terminal_(2, false), size_(0) {}
+
+  /**
+   * Inserts the string into the trie. This method is idempotent. Returns false
+   * if the string was empty, already in the trie or has characters outside
+   * the alphabet, in which case the trie is not modified.
+   */
+  bool Insert(std::string_view s) {
+    if (s.empty()) return false;
+    for (const auto c : s) {
+      if (Alphabet::Slot(c) == Alphabet::kInvalid) return false;
+    }
+
+    NodeIndex runner = kRoot;
+    for (const auto c : s) {
+      const auto slot = Alphabet::Slot(c);
+      NodeIndex next = children_[runner][slot];
+      if (next == kDead) {
+        next = NewNode();
+        children_[runner][slot] = next;
+      }
+      runner = next;
+    }
+    if (terminal_[runner]) return false;
+    terminal_[runner] = true;
+    ++size_;
+    return true;
+  }
+
+  /**
+   * Check if trie contains the prefix.
+   */
+  bool Contains(std::string_view s) const noexcept {
+    NodeIndex runner = kRoot;
+    for (const auto c : s) runner = children_[runner][Alphabet::Slot(c)];
+    return runner != kDead;
+  }
+
+  /**
+   * Removes the string from the trie. Nodes which no longer lead to any string
+   * are recycled by later insertions. Returns false if the string was not in
+   * the trie.
+   */
+  bool Erase(std::string_view s) {
+    std::vector<std::pair<NodeIndex, std::size_t>> path;
+    path.reserve(s.size());
+    NodeIndex runner = kRoot;
+    for (const auto c : s) {
+      const auto slot = Alphabet::Slot(c);
+      path.emplace_back(runner, slot);
+      runner = children_[runner][slot];
+      if (runner == kDead) return false;
+    }
+    if (!terminal_[runner]) return false;
+    terminal_[runner] = false;
+    --size_;
+
+    while (!path.empty() && !terminal_[runner] && IsLeaf(runner)) {
+      free_.push_back(runner);
+      runner = path.back().first;
+      children_[runner][path.back().second] = kDead;
+      path.pop_back();
+    }
+    return true;
+  }
+
+  /**
+   * Number of strings in the trie.
+   */
+  std::size_t Size() const noexcept { return size_; }
+
+  /**
+   * Number of nodes in the trie, including the root.
+   */
+  std::size_t NodeCount() const noexcept {
+    return children_.size() - 1 - free_.size();
+  }
+
+  /**
+   * Bytes allocated for nodes.
+   */
+  std::size_t MemoryUsage() const noexcept {
+    return children_.capacity() * sizeof(Slots) + terminal_.capacity() / 8 +
+           free_.capacity() * sizeof(NodeIndex);
+  }
+
+  /**
+   * Reserves space for the given number of nodes.
+   */
+  void Reserve(std::size_t nodes) {
+    children_.reserve(nodes + 1);
+    terminal_.reserve(nodes + 1);
+  }
+
+  /**
+   * Passes strings who match the given prefix into the given function
+   * callback, in alphabet order.
+   */
+  template <typename Callable>
+  void MatchWithCallback(std::string_view s, const Callable& callback) const {
+    NodeIndex runner = kRoot;
+    for (const auto c : s) runner = children_[runner][Alphabet::Slot(c)];
+    if (runner == kDead) return;
+    std::string buf(s);
+    if (terminal_[runner]) callback(buf);
+
+    std::stack<std::pair<std::size_t, std::pair<std::size_t, NodeIndex>>>
+        nodes;
+    PushChildren(nodes, s.size(), runner);
+    while (!nodes.empty()) {
+      auto tmp = nodes.top();
+      nodes.pop();
+
+      buf.resize(tmp.first);
+      Alphabet::Encode(static_cast<Symbol>(tmp.second.first), buf);
+      if (terminal_[tmp.second.second]) callback(buf);
+      PushChildren(nodes, buf.size(), tmp.second.second);
+    }
+  }
+
+ private:
+  // Slot kSize receives characters outside the alphabet and is never set
+  using Slots = std::array<NodeIndex, kSize + 1>;
+
+  // Index 0 is a dead node whose slots all point back to itself, so a failed
+  // lookup stays failed for the rest of the key
+  static constexpr NodeIndex kDead = 0;
+  static constexpr NodeIndex kRoot = 1;
+
+  NodeIndex NewNode() {
+    if (!free_.empty()) {
+      NodeIndex n = free_.back();
+      free_.pop_back();
+      return n;
+    }
+    children_.emplace_back();
+    terminal_.push_back(false);
+    return static_cast<NodeIndex>(children_.size() - 1);
+  }
+
+  bool IsLeaf(NodeIndex n) const noexcept {
+    for (std::size_t i = 0; i < kSize; ++i) {
+      if (children_[n][i] != kDead) return false;
+    }
+    return true;
+  }
+
+  template <typename Stack>
+  void PushChildren(Stack& nodes, std::size_t length, NodeIndex n) const {
+    // Pushed in reverse so the smallest slot is visited first
+    for (std::size_t i = kSize; i-- > 0;) {
+      if (children_[n][i] != kDead)
+        nodes.push(std::make_pair(length, std::make_pair(i, children_[n][i])));
+    }
+  }
+
+  std::vector<Slots> children_;
+  std::vector<bool> terminal_;
+  std::vector<NodeIndex> free_;
+  std::size_t size_;
+};  // class DenseTrie
+
+#endif  // DENSE_TRIE_H__
@@ -0,0 +1,174 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "durable_trie.h"
+#include "encoding.h"
+
+namespace {
+
+bool WriteAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    const auto n = ::write(fd, data.data(), data.size());
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data.remove_prefix(static_cast<std::size_t>(n));
+  }
+  return true;
+}
+
+bool SyncPath(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  const bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+}
+
+}  // namespace
+
+DurableTrie::DurableTrie() : log_fd_(-1), log_size_(0) {}
+
+DurableTrie::~DurableTrie() {
+  Sync();
+  Close();
+}
+
+bool DurableTrie::Open(const std::string& directory, const Options& options) {
+  if (log_fd_ >= 0) Sync();
+  Close();
+  trie_ = PrefixTrie();
+  options_ = options;
+  directory_ = directory;
+  pending_.clear();
+  log_size_ = 0;
+
+  if (::mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) return false;
+  std::ifstream in(CheckpointPath(), std::ios::binary);
+  if (in.is_open() && !trie_.Deserialize(in)) return false;
+
+  log_fd_ = ::open(LogPath().c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC,
+                   0644);
+  if (log_fd_ < 0) return false;
+  return Replay();
+}
+
+bool DurableTrie::Insert(std::string_view s) {
+  if (log_fd_ < 0 || !trie_.Insert(s)) return false;
+  return Append(kInsert, s);
+}
+
+bool DurableTrie::Erase(std::string_view s) {
+  if (log_fd_ < 0 || !trie_.Erase(s)) return false;
+  return Append(kErase, s);
+}
+
+bool DurableTrie::Sync() {
+  if (log_fd_ < 0) return false;
+  if (pending_.empty()) return true;
+  if (!WriteAll(log_fd_, pending_) ||
+      (options_.fsync && ::fdatasync(log_fd_) != 0)) {
+    // Cut off whatever part of the batch made it to the log, so the retry
+    // appends it directly after the last committed record rather than after
+    // a torn one, which would end the replay there
+    if (::ftruncate(log_fd_, static_cast<off_t>(log_size_)) != 0) Close();
+    return false;
+  }
+  log_size_ += pending_.size();
+  pending_.clear();
+
+  if (options_.checkpoint_bytes > 0 && log_size_ >= options_.checkpoint_bytes)
+    return Checkpoint();
+  return true;
+}
+
+bool DurableTrie::Checkpoint() {
+  if (!Sync()) return false;
+
+  // Write aside and rename so a crash leaves either checkpoint intact. The log
+  // is only truncated once the new checkpoint is in place; replaying a log
+  // already covered by the checkpoint is harmless since every record sets the
+  // final state of its string
+  const std::string tmp = CheckpointPath() + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!trie_.Serialize(out)) return false;
+  }
+  if (options_.fsync && !SyncPath(tmp)) return false;
+  if (::rename(tmp.c_str(), CheckpointPath().c_str()) != 0) return false;
+  if (options_.fsync && !SyncPath(directory_)) return false;
+
+  if (::ftruncate(log_fd_, 0) != 0) return false;
+  log_size_ = 0;
+  return !options_.fsync || ::fdatasync(log_fd_) == 0;
+}
+
+bool DurableTrie::Append(RecordType type, std::string_view s) {
+  // Record layout: CRC-32 of the rest (little endian), type, varint length,
+  // string bytes
+  std::string record(1, type);
+  PutVarint(record, s.size());
+  record.append(s);
+  const auto crc = Crc32(record);
+  for (int i = 0; i < 4; ++i)
+    pending_.push_back(static_cast<char>(crc >> (8 * i)));
+  pending_.append(record);
+
+  if (pending_.size() >= options_.group_commit_bytes) return Sync();
+  return true;
+}
+
+bool DurableTrie::Replay() {
+  struct stat st;
+  if (::fstat(log_fd_, &st) != 0) return false;
+  std::string data(static_cast<std::size_t>(st.st_size), '\0');
+  std::size_t read = 0;
+  while (read < data.size()) {
+    const auto n = ::pread(log_fd_, &data[read], data.size() - read, read);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    read += static_cast<std::size_t>(n);
+  }
+
+  std::size_t good = 0;
+  while (data.size() - good > 4) {
+    std::uint32_t crc = 0;
+    for (int i = 0; i < 4; ++i)
+      crc |= static_cast<std::uint32_t>(
+                 static_cast<unsigned char>(data[good + i]))
+             << (8 * i);
+    std::size_t pos = good + 5;
+    std::uint64_t length;
+    if (!GetVarint(data, pos, length) || data.size() - pos < length) break;
+    std::string_view record(&data[good + 4], pos + length - good - 4);
+    if (Crc32(record) != crc) break;
+
+    const std::string_view s(&data[pos], length);
+    if (record[0] == kInsert)
+      trie_.Insert(s);
+    else if (record[0] == kErase)
+      trie_.Erase(s);
+    else
+      break;
+    good = pos + length;
+  }
+
+  // Drop a torn tail so new records directly follow the last good one
+  if (good < data.size() && ::ftruncate(log_fd_, good) != 0) return false;
+  log_size_ = good;
+  return true;
+}
+
+void DurableTrie::Close() {
+  if (log_fd_ >= 0) ::close(log_fd_);
+  log_fd_ = -1;
+}
@@ -0,0 +1,99 @@
+#ifndef DURABLE_TRIE_H__
+#define DURABLE_TRIE_H__
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "prefix_trie.h"
+
+/**
+ * PrefixTrie with an optional durability layer. Every Insert and Erase is
+ * appended to a binary write-ahead log in the given directory, and the trie is
+ * periodically checkpointed in the serialized trie format (see
+ * PrefixTrie::Serialize), after which the log is truncated. Opening the
+ * directory loads the checkpoint and replays the log, so recovery time is
+ * bounded by the log tail rather than the full data set.
+ *
+ * Log records are group committed: they are buffered and written with a
+ * single fsync once `group_commit_bytes` accumulate or Sync() is called.
+ * Updates since the last commit are lost on a crash. Each record carries a
+ * CRC-32, and replay stops at the first torn or corrupt record.
+ */
+class DurableTrie {
+ public:
+  struct Options {
+    // Buffered log bytes which trigger a commit; 0 commits every update
+    std::size_t group_commit_bytes = 1 << 16;
+    // Log size which triggers a checkpoint; 0 disables automatic checkpoints
+    std::size_t checkpoint_bytes = 64 << 20;
+    // Whether commits and checkpoints fsync, trading durability for speed
+    bool fsync = true;
+  };
+
+  DurableTrie();
+  ~DurableTrie();
+
+  DurableTrie(const DurableTrie& o) = delete;
+  DurableTrie& operator=(const DurableTrie& o) = delete;
+
+  /**
+   * Opens (creating if needed) the trie stored in the given directory,
+   * loading its checkpoint and replaying its log. Returns false on I/O errors
+   * or a corrupt checkpoint.
+   */
+  bool Open(const std::string& directory, const Options& options);
+  bool Open(const std::string& directory) { return Open(directory, Options()); }
+
+  /**
+   * Logs and applies the insertion. The update is visible immediately and
+   * durable after the next commit. Returns false if the string was empty or
+   * already in the trie, in which case nothing is logged, if the trie is not
+   * open or if a commit triggered by this update failed; failed commits are
+   * retried by the next one. If the log cannot be cut back to its last commit
+   * after a failed write, the trie is closed rather than risk a torn record
+   * in the log.
+   */
+  bool Insert(std::string_view s);
+
+  /**
+   * Logs and applies the erasure. Returns false if the string was not in the
+   * trie, the trie is not open or a commit triggered by this update failed.
+   */
+  bool Erase(std::string_view s);
+
+  /**
+   * Commits all buffered log records.
+   */
+  bool Sync();
+
+  /**
+   * Writes a checkpoint of the current trie and truncates the log.
+   */
+  bool Checkpoint();
+
+  /**
+   * Read access to the trie. Updates must go through Insert and Erase.
+   */
+  const PrefixTrie& Trie() const noexcept { return trie_; }
+
+ private:
+  enum RecordType : char { kInsert = 1, kErase = 2 };
+
+  bool Append(RecordType type, std::string_view s);
+  bool Replay();
+  void Close();
+
+  std::string CheckpointPath() const { return directory_ + "/checkpoint"; }
+  std::string LogPath() const { return directory_ + "/wal"; }
+
+  PrefixTrie trie_;
+  Options options_;
+  std::string directory_;
+  int log_fd_;
+  // Encoded records not yet written to the log
+  std::string pending_;
+  // Bytes in the log file since the last checkpoint
+  std::size_t log_size_;
+};  // class DurableTrie
+
+#endif  // DURABLE_TRIE_H__
@@ -0,0 +1,70 @@
+#ifndef ENCODING_H__
+#define ENCODING_H__
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+
+/**
+ * Appends the value to `out` as a LEB128 varint.
+ */
+inline void PutVarint(std::string& out, std::uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<char>(v));
+}
+
+/**
+ * Reads a LEB128 varint at `pos` and advances `pos`. Returns false on
+ * truncated or overlong input.
+ */
+inline bool GetVarint(std::string_view data, std::size_t& pos,
+                      std::uint64_t& v) noexcept {
+  v = 0;
+  for (unsigned shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+    const auto b = static_cast<unsigned char>(data[pos++]);
+    v |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+/**
+ * Reads a LEB128 varint from the stream. Returns false on truncated or
+ * overlong input.
+ */
+inline bool ReadVarint(std::istream& in, std::uint64_t& v) {
+  v = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    const auto b = in.get();
+    if (b == std::istream::traits_type::eof()) return false;
+    v |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+/**
+ * CRC-32 (IEEE) of the data, continuing from `crc`.
+ */
+inline std::uint32_t Crc32(std::string_view data, std::uint32_t crc = 0) {
+  static const auto table = [] {
+    std::array<std::uint32_t, 256> t{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t c = i;
+      for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  crc = ~crc;
+  for (const auto c : data)
+    crc = table[(crc ^ static_cast<unsigned char>(c)) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+#endif  // ENCODING_H__
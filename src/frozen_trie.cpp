@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "frozen_trie.h"
+#include "prefix_trie.h"
+
+namespace {
+
+/**
+ * Pointer-free copy of the source trie in preorder, used to compute layouts.
+ */
+struct Scratch {
+  std::vector<bool> terminal;
+  std::vector<std::vector<std::pair<char, std::uint32_t>>> children;
+  std::vector<std::uint32_t> height;
+};
+
+/**
+ * Appends the nodes of `n`'s subtree at relative depth exactly `depth`, in
+ * lexicographic order.
+ */
+void CollectFrontier(const Scratch& t, std::uint32_t n, std::uint32_t depth,
+                     std::vector<std::uint32_t>& out) {
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> stack{{n, 0}};
+  while (!stack.empty()) {
+    auto top = stack.back();
+    stack.pop_back();
+    if (top.second == depth) {
+      out.push_back(top.first);
+      continue;
+    }
+    const auto& children = t.children[top.first];
+    for (auto it = children.rbegin(); it != children.rend(); ++it)
+      stack.emplace_back(it->second, top.second + 1);
+  }
+}
+
+/**
+ * Appends the nodes of `n`'s subtree within `h` levels in van Emde Boas order:
+ * the top half of the levels first, then each subtree hanging below them.
+ */
+void VanEmdeBoas(const Scratch& t, std::uint32_t n, std::uint32_t h,
+                 std::vector<std::uint32_t>& out) {
+  h = std::min(h, t.height[n]);
+  if (h == 1) {
+    out.push_back(n);
+    return;
+  }
+  const std::uint32_t top = (h + 1) / 2;
+  VanEmdeBoas(t, n, top, out);
+  std::vector<std::uint32_t> frontier;
+  CollectFrontier(t, n, top, frontier);
+  for (const auto f : frontier) VanEmdeBoas(t, f, h - top, out);
+}
+
+}  // namespace
+
+FrozenTrie::FrozenTrie(const PrefixTrie& trie, Layout layout)
+    : size_(trie.Size()) {
+  // Copy the source into preorder so parents precede their children. Each
+  // pending node remembers which edge of its parent to point at it
+  struct Pending {
+    const PrefixTrie::TrieNode* node;
+    std::uint32_t parent;
+    std::uint32_t edge;
+  };
+  Scratch t;
+  std::vector<Pending> stack{{trie.root_.get(), kNone, 0}};
+  while (!stack.empty()) {
+    const auto p = stack.back();
+    stack.pop_back();
+    const auto id = static_cast<std::uint32_t>(t.terminal.size());
+    if (p.parent != kNone) t.children[p.parent][p.edge].second = id;
+
+    t.terminal.push_back(p.node->IsTerminal());
+    t.children.emplace_back();
+    const auto sorted = PrefixTrie::SortedChildren(p.node);
+    for (const auto* c : sorted) t.children[id].emplace_back(c->Key(), kNone);
+    for (auto i = sorted.size(); i-- > 0;)
+      stack.push_back({sorted[i], id, static_cast<std::uint32_t>(i)});
+  }
+  t.height.assign(t.terminal.size(), 1);
+  for (auto id = t.terminal.size(); id-- > 0;) {
+    for (const auto& c : t.children[id])
+      t.height[id] = std::max(t.height[id], t.height[c.second] + 1);
+  }
+
+  std::vector<std::uint32_t> order;
+  order.reserve(t.terminal.size());
+  if (layout == Layout::kBreadthFirst) {
+    order.push_back(0);
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      for (const auto& c : t.children[order[i]]) order.push_back(c.second);
+    }
+  } else {
+    VanEmdeBoas(t, 0, t.height[0], order);
+  }
+
+  std::vector<std::uint32_t> position(order.size());
+  for (std::uint32_t i = 0; i < order.size(); ++i) position[order[i]] = i;
+  nodes_.reserve(order.size());
+  labels_.reserve(order.size() - 1);
+  targets_.reserve(order.size() - 1);
+  for (const auto id : order) {
+    nodes_.push_back({static_cast<std::uint32_t>(labels_.size()),
+                      static_cast<std::uint16_t>(t.children[id].size()),
+                      t.terminal[id]});
+    for (const auto& c : t.children[id]) {
+      labels_.push_back(c.first);
+      targets_.push_back(position[c.second]);
+    }
+  }
+}
@@ -0,0 +1,132 @@
+#ifndef FROZEN_TRIE_H__
+#define FROZEN_TRIE_H__
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class PrefixTrie;
+
+/**
+ * Read-only copy of a PrefixTrie packed into contiguous arrays, with nodes
+ * relaid out to improve cache behaviour. After a build, PrefixTrie nodes sit
+ * wherever the allocator put them, so a traversal misses cache at nearly every
+ * level; here the nodes a lookup visits in sequence are stored close together.
+ *
+ * Two layouts are available:
+ *   kBreadthFirst - level order, packing the hot top levels together
+ *   kVanEmdeBoas  - the top half of the levels is laid out recursively,
+ *                   followed by each bottom subtree laid out recursively, so
+ *                   any root-to-leaf walk touches O(log_B n) blocks whatever
+ *                   the cache line or page size B (cache oblivious)
+ */
+class FrozenTrie {
+ public:
+  enum class Layout { kBreadthFirst, kVanEmdeBoas };
+
+  explicit FrozenTrie(const PrefixTrie& trie,
+                      Layout layout = Layout::kVanEmdeBoas);
+
+  /**
+   * Copies the trie into memory from the given resource, e.g. one local to a
+   * NUMA node.
+   */
+  FrozenTrie(const FrozenTrie& o, std::pmr::memory_resource* resource)
+      : nodes_(o.nodes_, resource),
+        labels_(o.labels_, resource),
+        targets_(o.targets_, resource),
+        size_(o.size_) {}
+
+  /**
+   * Check if trie contains the prefix.
+   */
+  bool Contains(std::string_view s) const noexcept {
+    std::uint32_t runner = 0;
+    for (const auto c : s) {
+      runner = Child(runner, c);
+      if (runner == kNone) return false;
+    }
+    return true;
+  }
+
+  /**
+   * Number of strings in the trie.
+   */
+  std::size_t Size() const noexcept { return size_; }
+
+  /**
+   * Number of nodes in the trie, including the root.
+   */
+  std::size_t NodeCount() const noexcept { return nodes_.size(); }
+
+  /**
+   * Bytes used by the node and edge arrays.
+   */
+  std::size_t MemoryUsage() const noexcept {
+    return nodes_.capacity() * sizeof(Node) + labels_.capacity() +
+           targets_.capacity() * sizeof(std::uint32_t);
+  }
+
+  /**
+   * Passes strings who match the given prefix into the given function callback,
+   * in lexicographic order.
+   */
+  template <typename Callable>
+  void MatchWithCallback(std::string_view s, const Callable& callback) const {
+    std::uint32_t runner = 0;
+    for (const auto c : s) {
+      runner = Child(runner, c);
+      if (runner == kNone) return;
+    }
+
+    std::string buf(s);
+    if (nodes_[runner].terminal) callback(buf);
+    // (node, next edge) per level of the current path
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> path;
+    path.emplace_back(runner, 0);
+    while (!path.empty()) {
+      auto& top = path.back();
+      const auto& n = nodes_[top.first];
+      if (top.second == n.edge_count) {
+        path.pop_back();
+        if (!path.empty()) buf.pop_back();
+        continue;
+      }
+      const auto e = n.first_edge + top.second++;
+      buf.push_back(labels_[e]);
+      if (nodes_[targets_[e]].terminal) callback(buf);
+      path.emplace_back(targets_[e], 0);
+    }
+  }
+
+ private:
+  static constexpr std::uint32_t kNone = UINT32_MAX;
+
+  struct Node {
+    // Edges [first_edge, first_edge + edge_count) of labels_ and targets_,
+    // sorted by unsigned label
+    std::uint32_t first_edge;
+    std::uint16_t edge_count;
+    bool terminal;
+  };
+
+  std::uint32_t Child(std::uint32_t n, char c) const noexcept {
+    const auto& node = nodes_[n];
+    const char* labels = labels_.data() + node.first_edge;
+    for (std::uint32_t i = 0; i < node.edge_count; ++i) {
+      if (labels[i] == c) return targets_[node.first_edge + i];
+    }
+    return kNone;
+  }
+
+  std::pmr::vector<Node> nodes_;
+  // Edges of each node are stored in the same order as the nodes themselves
+  std::pmr::vector<char> labels_;
+  std::pmr::vector<std::uint32_t> targets_;
+  std::size_t size_;
+};  // class FrozenTrie
+
+#endif  // FROZEN_TRIE_H__
@@ -0,0 +1,154 @@
+#ifndef GENERATOR_H__
+#define GENERATOR_H__
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <new>
+#include <utility>
+
+/**
+ * Per-thread cache of freed coroutine frames. Enumerations started over and
+ * over, e.g. one per request, reuse the frames of finished ones instead of
+ * going to the allocator.
+ */
+class FrameCache {
+ public:
+  static void* Allocate(std::size_t size) {
+    for (auto& f : Local().frames_) {
+      if (f.block != nullptr && f.size == size) {
+        void* block = f.block;
+        f.block = nullptr;
+        return block;
+      }
+    }
+    return ::operator new(size);
+  }
+
+  static void Release(void* block, std::size_t size) noexcept {
+    for (auto& f : Local().frames_) {
+      if (f.block == nullptr) {
+        f.block = block;
+        f.size = size;
+        return;
+      }
+    }
+    ::operator delete(block);
+  }
+
+  ~FrameCache() {
+    for (auto& f : frames_) ::operator delete(f.block);
+  }
+
+ private:
+  static constexpr std::size_t kFrames = 8;
+
+  struct Frame {
+    void* block = nullptr;
+    std::size_t size = 0;
+  };
+
+  static FrameCache& Local() {
+    static thread_local FrameCache cache;
+    return cache;
+  }
+
+  Frame frames_[kFrames];
+};  // class FrameCache
+
+/**
+ * Minimal lazy generator coroutine in the spirit of C++23 std::generator,
+ * which this toolchain lacks. The body runs only as the generator is
+ * iterated, and each co_yield hands one value to the loop. Frames come from
+ * the FrameCache.
+ *
+ *   for (auto s : trie.Matches("pre")) ...
+ */
+template <typename T>
+class Generator {
+ public:
+  struct promise_type {
+    T value;
+
+    Generator get_return_object() noexcept {
+      return Generator(Handle::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    std::suspend_always yield_value(T v) noexcept {
+      value = std::move(v);
+      return {};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() { throw; }
+
+    static void* operator new(std::size_t size) {
+      return FrameCache::Allocate(size);
+    }
+    static void operator delete(void* block, std::size_t size) noexcept {
+      FrameCache::Release(block, size);
+    }
+  };
+
+  using Handle = std::coroutine_handle<promise_type>;
+
+  class Iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    Iterator() noexcept : handle_(nullptr) {}
+    explicit Iterator(Handle h) noexcept : handle_(h) {}
+
+    reference operator*() const noexcept { return handle_.promise().value; }
+    pointer operator->() const noexcept { return &handle_.promise().value; }
+
+    Iterator& operator++() {
+      handle_.resume();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    bool operator==(const Iterator& o) const noexcept {
+      return Done() == o.Done();
+    }
+    bool operator!=(const Iterator& o) const noexcept { return !(*this == o); }
+
+   private:
+    // The end iterator has no handle
+    bool Done() const noexcept { return !handle_ || handle_.done(); }
+
+    Handle handle_;
+  };  // class Iterator
+
+  Generator(Generator&& o) noexcept : handle_(std::exchange(o.handle_, {})) {}
+  Generator& operator=(Generator&& o) noexcept {
+    std::swap(handle_, o.handle_);
+    return *this;
+  }
+  Generator(const Generator& o) = delete;
+  Generator& operator=(const Generator& o) = delete;
+
+  ~Generator() {
+    if (handle_) handle_.destroy();
+  }
+
+  /**
+   * Runs the body to its first co_yield. Call once per generator.
+   */
+  Iterator begin() {
+    handle_.resume();
+    return Iterator(handle_);
+  }
+  Iterator end() noexcept { return Iterator(); }
+
+ private:
+  explicit Generator(Handle h) noexcept : handle_(h) {}
+
+  Handle handle_;
+};  // class Generator
+
+#endif  // GENERATOR_H__
@@ -0,0 +1,100 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "huge_page_resource.h"
+
+HugePageResource::HugePageResource(bool explicit_pages) noexcept
+    : explicit_pages_(explicit_pages),
+      next_chunk_size_(kHugePageSize),
+      cur_(nullptr),
+      end_(nullptr) {}
+
+HugePageResource::~HugePageResource() {
+  for (const auto& c : chunks_) {
+    if (c.heap) {
+      ::operator delete(c.base, std::align_val_t(kHugePageSize));
+    } else {
+#ifdef __linux__
+      munmap(c.base, c.size);
+#endif
+    }
+  }
+}
+
+void* HugePageResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+  auto p = reinterpret_cast<std::uintptr_t>(cur_);
+  p = (p + alignment - 1) & ~(alignment - 1);
+  if (cur_ == nullptr || p + bytes > reinterpret_cast<std::uintptr_t>(end_)) {
+    // Requests too large for the next chunk get one of their own
+    const std::size_t need =
+        (bytes + alignment + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    MapChunk(need > next_chunk_size_ ? need : next_chunk_size_);
+    p = reinterpret_cast<std::uintptr_t>(cur_);
+    p = (p + alignment - 1) & ~(alignment - 1);
+  }
+  cur_ = reinterpret_cast<char*>(p + bytes);
+  return reinterpret_cast<void*>(p);
+}
+
+void HugePageResource::do_deallocate(void*, std::size_t, std::size_t) {}
+
+bool HugePageResource::do_is_equal(
+    const std::pmr::memory_resource& o) const noexcept {
+  return this == &o;
+}
+
+void HugePageResource::MapChunk(std::size_t bytes) {
+  if (next_chunk_size_ < kMaxChunkSize) next_chunk_size_ *= 2;
+  void* base = nullptr;
+#ifdef __linux__
+  if (explicit_pages_) {
+    // Fails unless enough pages are reserved in /proc/sys/vm/nr_hugepages
+    base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (base != MAP_FAILED) {
+      stats_.explicit_bytes += bytes;
+    } else {
+      base = nullptr;
+    }
+  }
+  if (base == nullptr) {
+    // Over-allocate by a huge page and trim, so the chunk is 2 MB aligned and
+    // every one of its pages can be backed by a huge page
+    const std::size_t mapped = bytes + kHugePageSize;
+    void* raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw != MAP_FAILED) {
+      const auto start = reinterpret_cast<std::uintptr_t>(raw);
+      const auto aligned =
+          (start + kHugePageSize - 1) & ~(kHugePageSize - 1);
+      if (aligned > start) munmap(raw, aligned - start);
+      const std::size_t tail = kHugePageSize - (aligned - start);
+      if (tail > 0) munmap(reinterpret_cast<char*>(aligned + bytes), tail);
+      base = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+      if (madvise(base, bytes, MADV_HUGEPAGE) == 0)
+        stats_.transparent_bytes += bytes;
+      else
+        stats_.fallback_bytes += bytes;
+#else
+      stats_.fallback_bytes += bytes;
+#endif
+    }
+  }
+#endif
+  const bool heap = base == nullptr;
+  if (heap) {
+    base = ::operator new(bytes, std::align_val_t(kHugePageSize));
+    stats_.fallback_bytes += bytes;
+  }
+  chunks_.push_back({base, bytes, heap});
+  cur_ = static_cast<char*>(base);
+  end_ = cur_ + bytes;
+}
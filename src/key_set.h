@@ -0,0 +1,187 @@
+#ifndef KEY_SET_H__
+#define KEY_SET_H__
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Open-addressing hash index from keys to the nodes they end at. Keys are not
+ * stored: a slot holds the key's hash, its length and a second fingerprint
+ * under a per-process random seed, plus its node, 24 bytes whatever the key
+ * length. A lookup only matches a slot if all three agree, so keys crafted to
+ * collide under std::hash, whose seed is fixed, are still told apart.
+ * Erasure shifts later entries of the probe run back instead of leaving
+ * tombstones.
+ */
+template <typename Node>
+class KeySet {
+ public:
+  /**
+   * What the index keeps of a key. The hash picks the slot; the length (cut
+   * to 32 bits) and the fingerprint confirm a match.
+   */
+  struct Key {
+    std::size_t hash = kEmpty;
+    std::uint32_t length = 0;
+    std::uint32_t fingerprint = 0;
+
+    bool operator==(const Key& o) const noexcept {
+      return hash == o.hash && length == o.length &&
+             fingerprint == o.fingerprint;
+    }
+  };
+
+  KeySet() : slots_(kMinCapacity), size_(0) {}
+
+  static Key Hash(std::string_view key) noexcept {
+    Key k;
+    // Reserve 0 for empty slots
+    k.hash = std::hash<std::string_view>()(key);
+    if (k.hash == kEmpty) k.hash = 1;
+    k.length = static_cast<std::uint32_t>(key.size());
+    k.fingerprint = Fingerprint(key);
+    return k;
+  }
+
+  std::size_t Size() const noexcept { return size_; }
+
+  /**
+   * Adds the node under the key. Returns false if it was already present.
+   */
+  bool Insert(const Key& key, Node* node) {
+    if ((size_ + 1) * 4 > slots_.size() * 3) Grow();
+    auto i = Probe(key.hash, node);
+    if (slots_[i].key.hash != kEmpty) return false;
+    slots_[i] = {key, node};
+    ++size_;
+    return true;
+  }
+
+  /**
+   * Removes the node from under the key. Returns false if it was not
+   * present.
+   */
+  bool Erase(const Key& key, const Node* node) noexcept {
+    auto i = Probe(key.hash, node);
+    if (slots_[i].key.hash == kEmpty) return false;
+    const auto mask = slots_.size() - 1;
+    // Move back every later entry of the run whose home slot is not between
+    // the hole and its current slot
+    for (auto j = (i + 1) & mask; slots_[j].key.hash != kEmpty;
+         j = (j + 1) & mask) {
+      const auto home = slots_[j].key.hash & mask;
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+        std::swap(slots_[i], slots_[j]);
+        i = j;
+      }
+    }
+    slots_[i] = Slot();
+    --size_;
+    return true;
+  }
+
+  /**
+   * Returns the node under the key, or nullptr.
+   */
+  Node* Find(const Key& key) const noexcept {
+    const auto mask = slots_.size() - 1;
+    for (auto i = key.hash & mask; slots_[i].key.hash != kEmpty;
+         i = (i + 1) & mask) {
+      if (slots_[i].key == key) return slots_[i].node;
+    }
+    return nullptr;
+  }
+
+  /**
+   * Calls f(key, node) for every entry.
+   */
+  template <typename F>
+  void ForEach(const F& f) const {
+    for (const auto& s : slots_) {
+      if (s.key.hash != kEmpty) f(s.key, s.node);
+    }
+  }
+
+  void Clear() noexcept {
+    for (auto& s : slots_) s = Slot();
+    size_ = 0;
+  }
+
+  /**
+   * Heap usage in bytes.
+   */
+  std::size_t MemoryUsage() const noexcept {
+    return slots_.capacity() * sizeof(Slot);
+  }
+
+ private:
+  static constexpr std::size_t kEmpty = 0;
+  static constexpr std::size_t kMinCapacity = 16;
+
+  struct Slot {
+    Key key;
+    Node* node = nullptr;
+  };
+
+  /**
+   * Seeded hash of the key, independent of std::hash. Every 8 bytes are
+   * folded into a state which is remixed in between, so a collision needs
+   * the seed-dependent state.
+   */
+  static std::uint32_t Fingerprint(std::string_view key) noexcept {
+    static const std::uint64_t seed =
+        (std::uint64_t{std::random_device()()} << 32) ^ std::random_device()();
+    auto mix = [](std::uint64_t x) {
+      x ^= x >> 32;
+      x *= 0xd6e8feb86659fd93ULL;
+      x ^= x >> 32;
+      x *= 0xd6e8feb86659fd93ULL;
+      return x ^ (x >> 32);
+    };
+    std::uint64_t h = mix(seed ^ key.size());
+    std::size_t i = 0;
+    for (; i + 8 <= key.size(); i += 8) {
+      std::uint64_t w;
+      std::memcpy(&w, key.data() + i, 8);
+      h = mix(h ^ w);
+    }
+    std::uint64_t w = 0;
+    if (i < key.size()) std::memcpy(&w, key.data() + i, key.size() - i);
+    return static_cast<std::uint32_t>(mix(h ^ w ^ seed));
+  }
+
+  /**
+   * Returns the slot holding the entry or the empty slot ending its probe run.
+   */
+  std::size_t Probe(std::size_t hash, const Node* node) const noexcept {
+    const auto mask = slots_.size() - 1;
+    auto i = hash & mask;
+    while (slots_[i].key.hash != kEmpty &&
+           (slots_[i].key.hash != hash || slots_[i].node != node))
+      i = (i + 1) & mask;
+    return i;
+  }
+
+  void Grow() {
+    std::vector<Slot> old(slots_.size() * 2);
+    old.swap(slots_);
+    const auto mask = slots_.size() - 1;
+    for (const auto& s : old) {
+      if (s.key.hash == kEmpty) continue;
+      auto i = s.key.hash & mask;
+      while (slots_[i].key.hash != kEmpty) i = (i + 1) & mask;
+      slots_[i] = s;
+    }
+  }
+
+  // Power of two size, at most three quarters full
+  std::vector<Slot> slots_;
+  std::size_t size_;
+};  // class KeySet
+
+#endif  // KEY_SET_H__
@@ -0,0 +1,103 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "metrics.h"
+
+namespace {
+
+constexpr const char* kOpNames[] = {
+    "insert", "erase",      "contains",       "contains_key", "count_prefix",
+    "match",  "match_from", "parallel_match", "key_at",       "rank_of"};
+static_assert(sizeof(kOpNames) / sizeof(kOpNames[0]) ==
+                  static_cast<std::size_t>(TrieOp::kNumOps),
+              "every operation needs a name");
+
+}  // namespace
+
+std::uint64_t LatencyHistogram::Percentile(double q) const noexcept {
+  const std::uint64_t count = Count();
+  if (count == 0) return 0;
+  // Rank of the quantile among the recorded values, 1-based
+  auto rank = static_cast<std::uint64_t>(q * static_cast<double>(count));
+  if (rank == 0) rank = 1;
+  if (rank > count) rank = count;
+  std::uint64_t seen = 0;
+  std::size_t last = 0;
+  for (std::size_t b = 0; b < kBuckets; ++b) {
+    const auto n = buckets_[b].load(std::memory_order_relaxed);
+    if (n == 0) continue;
+    last = b;
+    seen += n;
+    if (seen >= rank) return LowerBound(b);
+  }
+  // Records racing with this read may leave the buckets behind count_
+  return LowerBound(last);
+}
+
+void LatencyHistogram::Reset() noexcept {
+  for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::LowerBound(std::size_t bucket) noexcept {
+  if (bucket < (1u << kSubBits)) return bucket;
+  const unsigned e = static_cast<unsigned>(bucket >> kSubBits) + kSubBits - 1;
+  const std::uint64_t sub = bucket & ((1u << kSubBits) - 1);
+  return ((std::uint64_t{1} << kSubBits) + sub) << (e - kSubBits);
+}
+
+TrieMetrics& TrieMetrics::Global() noexcept {
+  static TrieMetrics metrics;
+  return metrics;
+}
+
+std::string TrieMetrics::ToText() const {
+  std::ostringstream out;
+  out << "op calls nodes mean_ns p50_ns p90_ns p99_ns max_ns\n";
+  for (std::size_t i = 0; i < static_cast<std::size_t>(TrieOp::kNumOps); ++i) {
+    const auto& stats = ops_[i];
+    const auto calls = stats.latency.Count();
+    out << kOpNames[i] << ' ' << calls << ' '
+        << stats.nodes.load(std::memory_order_relaxed) << ' '
+        << (calls == 0 ? 0 : stats.latency.Sum() / calls) << ' '
+        << stats.latency.Percentile(0.5) << ' '
+        << stats.latency.Percentile(0.9) << ' '
+        << stats.latency.Percentile(0.99) << ' '
+        << stats.latency.Max() << '\n';
+  }
+  out << "allocations " << allocations_.load(std::memory_order_relaxed)
+      << '\n';
+  return out.str();
+}
+
+std::string TrieMetrics::ToJson() const {
+  std::ostringstream out;
+  out << '{';
+  for (std::size_t i = 0; i < static_cast<std::size_t>(TrieOp::kNumOps); ++i) {
+    const auto& stats = ops_[i];
+    const auto calls = stats.latency.Count();
+    out << '"' << kOpNames[i] << "\":{\"calls\":" << calls
+        << ",\"nodes\":" << stats.nodes.load(std::memory_order_relaxed)
+        << ",\"mean_ns\":" << (calls == 0 ? 0 : stats.latency.Sum() / calls)
+        << ",\"p50_ns\":" << stats.latency.Percentile(0.5)
+        << ",\"p90_ns\":" << stats.latency.Percentile(0.9)
+        << ",\"p99_ns\":" << stats.latency.Percentile(0.99)
+        << ",\"max_ns\":" << stats.latency.Max() << "},";
+  }
+  out << "\"allocations\":" << allocations_.load(std::memory_order_relaxed)
+      << '}';
+  return out.str();
+}
+
+void TrieMetrics::Reset() noexcept {
+  for (auto& stats : ops_) {
+    stats.nodes.store(0, std::memory_order_relaxed);
+    stats.latency.Reset();
+  }
+  allocations_.store(0, std::memory_order_relaxed);
+}
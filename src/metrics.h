@@ -0,0 +1,183 @@
+#ifndef METRICS_H__
+#define METRICS_H__
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Operations instrumented by the metrics layer.
+ */
+enum class TrieOp {
+  kInsert,
+  kErase,
+  kContains,
+  kContainsKey,
+  kCountPrefix,
+  kMatch,
+  kMatchFrom,
+  kParallelMatch,
+  kKeyAt,
+  kRankOf,
+  kNumOps
+};
+
+/**
+ * Lock-free latency histogram with HDR-style log-linear buckets: every power
+ * of two is split into 8 linear sub-buckets, so recorded values keep three
+ * significant bits (at most 12.5% error) over the full 64-bit range.
+ */
+class LatencyHistogram {
+ public:
+  void Record(std::uint64_t ns) noexcept {
+    buckets_[BucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(ns, std::memory_order_relaxed);
+    auto max = max_.load(std::memory_order_relaxed);
+    while (ns > max &&
+           !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  std::uint64_t Count() const noexcept {
+    return count_.load(std::memory_order_relaxed);
+  }
+  std::uint64_t Sum() const noexcept {
+    return sum_.load(std::memory_order_relaxed);
+  }
+  /**
+   * Exact largest recorded value, unlike the bucketed percentiles.
+   */
+  std::uint64_t Max() const noexcept {
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Lower bound of the bucket holding the given quantile, in [0, 1].
+   */
+  std::uint64_t Percentile(double q) const noexcept;
+
+  void Reset() noexcept;
+
+ private:
+  static constexpr unsigned kSubBits = 3;
+  static constexpr std::size_t kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+  static std::size_t BucketOf(std::uint64_t v) noexcept {
+    if (v < (1u << kSubBits)) return static_cast<std::size_t>(v);
+    const unsigned e = 63 - __builtin_clzll(v);
+    const auto sub = (v >> (e - kSubBits)) & ((1u << kSubBits) - 1);
+    return ((e - kSubBits + 1) << kSubBits) + sub;
+  }
+  static std::uint64_t LowerBound(std::size_t bucket) noexcept;
+
+  std::atomic<std::uint64_t> buckets_[kBuckets] = {};
+  std::atomic<std::uint64_t> count_{0};
+  std::atomic<std::uint64_t> sum_{0};
+  std::atomic<std::uint64_t> max_{0};
+};  // class LatencyHistogram
+
+/**
+ * Process-wide counters and latency histograms of trie operations. Only
+ * builds with PREFIX_TRIE_METRICS record anything, see TrieMetricsScope.
+ */
+class TrieMetrics {
+ public:
+  static TrieMetrics& Global() noexcept;
+
+  void Record(TrieOp op, std::uint64_t ns, std::uint64_t nodes) noexcept {
+    auto& stats = ops_[static_cast<std::size_t>(op)];
+    stats.nodes.fetch_add(nodes, std::memory_order_relaxed);
+    stats.latency.Record(ns);
+  }
+
+  void CountAllocations(std::uint64_t n) noexcept {
+    allocations_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /**
+   * Snapshot as lines of "op calls nodes mean_ns p50_ns p90_ns p99_ns
+   * max_ns", followed by the allocation count.
+   */
+  std::string ToText() const;
+
+  /**
+   * Snapshot as a JSON object keyed by operation.
+   */
+  std::string ToJson() const;
+
+  void Reset() noexcept;
+
+ private:
+  struct OpStats {
+    std::atomic<std::uint64_t> nodes{0};
+    LatencyHistogram latency;
+  };
+
+  OpStats ops_[static_cast<std::size_t>(TrieOp::kNumOps)];
+  std::atomic<std::uint64_t> allocations_{0};
+};  // class TrieMetrics
+
+/**
+ * Nodes visited by trie operations on this thread so far.
+ */
+inline std::uint64_t& NodeVisits() noexcept {
+  static thread_local std::uint64_t visits = 0;
+  return visits;
+}
+
+/**
+ * Times an operation from construction to destruction and records it along
+ * with the nodes the thread visited in between.
+ */
+class MetricsScope {
+ public:
+  explicit MetricsScope(TrieOp op) noexcept
+      : op_(op),
+        visits_(NodeVisits()),
+        start_(std::chrono::steady_clock::now()) {}
+  ~MetricsScope() {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start_)
+                        .count();
+    TrieMetrics::Global().Record(op_, static_cast<std::uint64_t>(ns),
+                                 NodeVisits() - visits_);
+  }
+
+  MetricsScope(const MetricsScope& o) = delete;
+  MetricsScope& operator=(const MetricsScope& o) = delete;
+
+ private:
+  TrieOp op_;
+  std::uint64_t visits_;
+  std::chrono::steady_clock::time_point start_;
+};  // class MetricsScope
+
+/**
+ * No-op stand-in for MetricsScope, compiled away entirely.
+ */
+class NoMetricsScope {
+ public:
+  explicit NoMetricsScope(TrieOp) noexcept {}
+};  // class NoMetricsScope
+
+/**
+ * The trie code is instrumented through these names only, so builds without
+ * PREFIX_TRIE_METRICS pay nothing for it.
+ */
+#ifdef PREFIX_TRIE_METRICS
+constexpr bool kMetricsEnabled = true;
+using TrieMetricsScope = MetricsScope;
+inline void CountNodeVisits(std::size_t n) noexcept { NodeVisits() += n; }
+inline void CountNodeAllocations(std::size_t n) noexcept {
+  TrieMetrics::Global().CountAllocations(n);
+}
+#else
+constexpr bool kMetricsEnabled = false;
+using TrieMetricsScope = NoMetricsScope;
+inline void CountNodeVisits(std::size_t) noexcept {}
+inline void CountNodeAllocations(std::size_t) noexcept {}
+#endif
+
+#endif  // METRICS_H__
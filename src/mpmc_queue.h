@@ -0,0 +1,95 @@
+#ifndef MPMC_QUEUE_H__
+#define MPMC_QUEUE_H__
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/**
+ * Bounded lock-free multi-producer multi-consumer queue (Vyukov's array
+ * queue). Each cell carries a sequence number telling producers and consumers
+ * whose turn it is, so a push or pop is a single CAS on the shared position
+ * followed by uncontended accesses to the claimed cell.
+ */
+template <typename T>
+class MpmcQueue {
+ public:
+  /**
+   * The capacity is rounded up to a power of two.
+   */
+  explicit MpmcQueue(std::size_t capacity) : enqueue_(0), dequeue_(0) {
+    std::size_t size = 2;
+    while (size < capacity) size <<= 1;
+    mask_ = size - 1;
+    cells_ = std::make_unique<Cell[]>(size);
+    for (std::size_t i = 0; i < size; ++i)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  MpmcQueue(const MpmcQueue& o) = delete;
+  MpmcQueue& operator=(const MpmcQueue& o) = delete;
+
+  /**
+   * Moves the value into the queue. Returns false if the queue is full.
+   */
+  bool TryPush(T& value) {
+    auto pos = enqueue_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const auto seq = cell->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (enqueue_.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Moves the oldest value out of the queue. Returns false if it is empty.
+   */
+  bool TryPop(T& value) {
+    auto pos = dequeue_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const auto seq = cell->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (dequeue_.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(cell->value);
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  std::size_t mask_;
+  // Producers and consumers contend on different cache lines
+  alignas(64) std::atomic<std::size_t> enqueue_;
+  alignas(64) std::atomic<std::size_t> dequeue_;
+};  // class MpmcQueue
+
+#endif  // MPMC_QUEUE_H__
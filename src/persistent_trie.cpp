@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "persistent_trie.h"
+
+namespace {
+
+template <typename Pair>
+bool EdgeLess(const Pair& e, char c) {
+  return static_cast<unsigned char>(e.first) < static_cast<unsigned char>(c);
+}
+
+}  // namespace
+
+PersistentTrie::PersistentTrie() : root_(std::make_shared<const Node>()) {}
+
+PersistentTrie PersistentTrie::Insert(std::string_view s) const {
+  if (s.empty()) return *this;
+  const Node* existing = FindNode(s);
+  if (existing != nullptr && existing->terminal) return *this;
+
+  auto leaf = existing == nullptr ? std::make_shared<Node>()
+                                  : std::make_shared<Node>(*existing);
+  leaf->terminal = true;
+  ++leaf->count;
+  return CopyPath(s, std::move(leaf), 1);
+}
+
+PersistentTrie PersistentTrie::Erase(std::string_view s) const {
+  const Node* existing = FindNode(s);
+  if (existing == nullptr || !existing->terminal) return *this;
+
+  // A node holding only the erased string disappears together with its edge
+  std::shared_ptr<Node> leaf;
+  if (existing->count > 1) {
+    leaf = std::make_shared<Node>(*existing);
+    leaf->terminal = false;
+    --leaf->count;
+  }
+  return CopyPath(s, std::move(leaf), -1);
+}
+
+bool PersistentTrie::Contains(std::string_view s) const noexcept {
+  return FindNode(s) != nullptr;
+}
+
+std::size_t PersistentTrie::CountPrefix(std::string_view s) const noexcept {
+  const Node* runner = FindNode(s);
+  return runner == nullptr ? 0 : runner->count;
+}
+
+const PersistentTrie::Node* PersistentTrie::Node::Find(char c) const noexcept {
+  auto it = std::lower_bound(children.begin(), children.end(), c,
+                             EdgeLess<decltype(children)::value_type>);
+  if (it == children.end() || it->first != c) return nullptr;
+  return it->second.get();
+}
+
+const PersistentTrie::Node* PersistentTrie::FindNode(std::string_view s) const
+    noexcept {
+  const Node* runner = root_.get();
+  for (const auto c : s) {
+    runner = runner->Find(c);
+    if (runner == nullptr) return nullptr;
+  }
+  return runner;
+}
+
+PersistentTrie PersistentTrie::CopyPath(std::string_view s,
+                                        std::shared_ptr<const Node> leaf,
+                                        long delta) const {
+  // Nodes of this version along s, nullptr past the end of the existing path
+  std::vector<const Node*> path(s.size(), nullptr);
+  path[0] = root_.get();
+  for (std::size_t i = 1; i < s.size() && path[i - 1] != nullptr; ++i)
+    path[i] = path[i - 1]->Find(s[i - 1]);
+
+  // Rebuild bottom-up, each copy pointing at the copy made below it
+  std::shared_ptr<const Node> child = std::move(leaf);
+  for (std::size_t i = s.size(); i-- > 0;) {
+    auto node = path[i] == nullptr ? std::make_shared<Node>()
+                                   : std::make_shared<Node>(*path[i]);
+    node->count = static_cast<std::size_t>(static_cast<long>(node->count) +
+                                           delta);
+    auto& children = node->children;
+    auto it = std::lower_bound(children.begin(), children.end(), s[i],
+                               EdgeLess<decltype(node->children)::value_type>);
+    if (it != children.end() && it->first == s[i]) {
+      if (child)
+        it->second = std::move(child);
+      else
+        children.erase(it);
+    } else if (child) {
+      children.emplace(it, s[i], std::move(child));
+    }
+    // Nodes left without strings can only come from Erase and are dropped,
+    // except for the root
+    if (node->count == 0 && i > 0)
+      child.reset();
+    else
+      child = std::move(node);
+  }
+  return PersistentTrie(std::move(child));
+}
@@ -0,0 +1,106 @@
+#ifndef PERSISTENT_TRIE_H__
+#define PERSISTENT_TRIE_H__
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Persistent (immutable) prefix trie. Insert and Erase leave the trie they are
+ * called on untouched and return a new version which copies only the nodes on
+ * the path of the modified string and shares every other subtree.
+ *
+ * Copying a PersistentTrie is O(1), so it doubles as a point-in-time
+ * snapshot: readers keep using the version they hold while a writer derives
+ * new ones, without any locking. Nodes are reference counted and freed once
+ * no version refers to them. To hand versions between threads, publish them
+ * through std::atomic_load/std::atomic_store on a std::shared_ptr or under a
+ * mutex held only for the copy.
+ */
+class PersistentTrie {
+ public:
+  PersistentTrie();
+
+  /**
+   * Returns a version which also contains the string. Returns a copy of this
+   * version if the string is empty or already present.
+   */
+  PersistentTrie Insert(std::string_view s) const;
+
+  /**
+   * Returns a version without the string. Returns a copy of this version if
+   * the string is not present.
+   */
+  PersistentTrie Erase(std::string_view s) const;
+
+  /**
+   * Check if this version contains the prefix.
+   */
+  bool Contains(std::string_view s) const noexcept;
+
+  /**
+   * Number of strings in this version which start with the given prefix.
+   */
+  std::size_t CountPrefix(std::string_view s) const noexcept;
+
+  /**
+   * Number of strings in this version.
+   */
+  std::size_t Size() const noexcept { return root_->count; }
+
+  /**
+   * Passes strings who match the given prefix into the given function callback,
+   * in lexicographic order.
+   */
+  template <typename Callable>
+  void MatchWithCallback(std::string_view s, const Callable& callback) const {
+    const Node* runner = FindNode(s);
+    if (runner == nullptr) return;
+
+    std::string buf(s);
+    if (runner->terminal) callback(buf);
+    std::vector<std::pair<const Node*, std::size_t>> path;
+    path.emplace_back(runner, 0);
+    while (!path.empty()) {
+      auto& top = path.back();
+      if (top.second == top.first->children.size()) {
+        path.pop_back();
+        if (!path.empty()) buf.pop_back();
+        continue;
+      }
+      const auto& child = top.first->children[top.second++];
+      buf.push_back(child.first);
+      if (child.second->terminal) callback(buf);
+      path.emplace_back(child.second.get(), 0);
+    }
+  }
+
+ private:
+  struct Node {
+    bool terminal = false;
+    // Number of strings ending in this subtree, including at this node
+    std::size_t count = 0;
+    // Sorted by unsigned character value, copied whole on every path copy
+    std::vector<std::pair<char, std::shared_ptr<const Node>>> children;
+
+    const Node* Find(char c) const noexcept;
+  };
+
+  explicit PersistentTrie(std::shared_ptr<const Node> root)
+      : root_(std::move(root)) {}
+
+  const Node* FindNode(std::string_view s) const noexcept;
+
+  /**
+   * Copies the nodes along s and replaces the node at its end by `leaf`
+   * (removing the edge if it is null), adjusting counts by `delta`.
+   */
+  PersistentTrie CopyPath(std::string_view s, std::shared_ptr<const Node> leaf,
+                          long delta) const;
+
+  std::shared_ptr<const Node> root_;
+};  // class PersistentTrie
+
+#endif  // PERSISTENT_TRIE_H__
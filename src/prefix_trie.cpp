@@ -1,42 +1,502 @@
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <new>
 #include <set>
 #include <sstream>
 #include <stack>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "encoding.h"
+#include "metrics.h"
 #include "prefix_trie.h"
 
-void PrefixTrie::Insert(const std::string& s) noexcept {
-  if (s.empty()) return;
+namespace {
+
+constexpr char kMagic[] = "PTR1";
+constexpr std::size_t kWriteChunk = 1 << 16;
+constexpr std::size_t kReadChunk = 1 << 16;
+
+}  // namespace
+
+bool PrefixTrie::Insert(std::string_view s) {
+  if (s.empty()) return false;
+  TrieMetricsScope metrics(TrieOp::kInsert);
   TrieNode* runner = root_.get();
   std::size_t cur_index = 0;
-  while (!runner->Children().empty() && cur_index < s.size()) {
-    if (runner->Children().find(s[cur_index]) == runner->Children().end())
-      break;
-    runner = runner->Children()[s[cur_index]].get();
-    ++cur_index;
-  }
   while (cur_index < s.size()) {
-    runner->Children()[s[cur_index]] = std::make_unique<TrieNode>(s[cur_index]);
-    runner = runner->Children()[s[cur_index]].get();
+    TrieNode* next = Child(runner, s, cur_index);
+    if (next == nullptr) break;
+    runner = next;
     ++cur_index;
   }
-  runner->Children()[s[cur_index - 1]] = std::make_unique<TrieNode>('\0');
+  if (cur_index == s.size() && runner->IsTerminal()) return false;
+
+  // Everything which may throw, i.e. allocating the missing nodes, their jump
+  // table level and the key index entry, happens before the trie is touched,
+  // so a failed allocation leaves it unchanged
+  const std::size_t added = s.size() - cur_index;
+  auto& jump = (*jump_)[static_cast<unsigned char>(s[0])];
+  if (cur_index < kJumpDepth && s.size() >= kJumpDepth && !jump.next)
+    jump.next = std::make_unique<JumpLevel>();
+  NodePtr chain;
+  TrieNode* terminal = runner;
+  std::array<TrieNode*, kJumpDepth> shallow{};
+  for (std::size_t i = cur_index; i < s.size(); ++i) {
+    auto node = MakeNode(s[i], resource_);
+    node->AddCount(1);
+    node->AddNodes(s.size() - i - 1);
+    TrieNode* raw = node.get();
+    if (chain)
+      terminal->Children().emplace(s[i], std::move(node));
+    else
+      chain = std::move(node);
+    terminal = raw;
+    if (i < kJumpDepth) shallow[i] = raw;
+  }
+  CountNodeAllocations(added);
+  const auto key = keys_ ? KeySet<TrieNode>::Hash(s) : KeySet<TrieNode>::Key();
+  if (keys_) keys_->Insert(key, terminal);
+  if (chain) {
+    try {
+      runner->Children().emplace(s[cur_index], std::move(chain));
+    } catch (...) {
+      if (keys_) keys_->Erase(key, terminal);
+      throw;
+    }
+  }
+
+  // Only the existing prefixes of s gain a match, and the nodes added below
+  // them; new nodes are not cached
+  terminal->SetTerminal(true);
+  TrieNode* node = root_.get();
+  node->AddCount(1);
+  node->AddNodes(added);
+  InvalidateCached(node, false);
+  for (std::size_t i = 0; i < cur_index; ++i) {
+    node = Child(node, s, i);
+    node->AddCount(1);
+    node->AddNodes(added);
+    InvalidateCached(node, false);
+  }
+  for (std::size_t i = cur_index; i < std::min(s.size(), kJumpDepth); ++i)
+    SetJump(s, i, shallow[i]);
+  if (bloom_) AddToBloomFilter(s);
+  return true;
 }
 
-bool PrefixTrie::Contains(const std::string& s) const noexcept {
-  if (s.empty()) return true;
+bool PrefixTrie::Contains(std::string_view s) const noexcept {
+  TrieMetricsScope metrics(TrieOp::kContains);
+  return FindNode(s) != nullptr;
+}
 
+bool PrefixTrie::ContainsKey(std::string_view s) const noexcept {
+  TrieMetricsScope metrics(TrieOp::kContainsKey);
+  if (keys_) return keys_->Find(KeySet<TrieNode>::Hash(s)) != nullptr;
+  TrieNode* runner = FindNode(s);
+  return runner != nullptr && runner->IsTerminal();
+}
+
+bool PrefixTrie::Erase(std::string_view s) noexcept {
+  TrieMetricsScope metrics(TrieOp::kErase);
+  // Find the string's node and the first node on its path which leads to no
+  // other string. That node only continues the path of the erased string, so
+  // it and the whole remaining chain can be dropped at once
   TrieNode* runner = root_.get();
-  std::size_t cur_index = 0;
-  while (!runner->Children().empty() && cur_index < s.size()) {
-    if (runner->Children().find(s[cur_index]) == runner->Children().end())
+  std::size_t dead = s.size();
+  for (std::size_t i = 0; i < s.size(); ++i) {
+    runner = Child(runner, s, i);
+    if (runner == nullptr) return false;
+    if (dead == s.size() && runner->Count() == 1) dead = i;
+  }
+  if (!runner->IsTerminal()) return false;
+  runner->SetTerminal(false);
+  if (keys_) keys_->Erase(KeySet<TrieNode>::Hash(s), runner);
+
+  const std::size_t removed = s.size() - dead;
+  runner = root_.get();
+  runner->SubtractCount(1);
+  runner->SubtractNodes(removed);
+  InvalidateCached(runner, false);
+  for (std::size_t i = 0; i < s.size(); ++i) {
+    auto it = runner->Children().find(s[i]);
+    if (i == dead) {
+      if (cache_) {
+        for (TrieNode* node = it->second.get(); node != nullptr;) {
+          InvalidateCached(node, true);
+          auto next = node->Children().begin();
+          node = next == node->Children().end() ? nullptr : next->second.get();
+        }
+      }
+      runner->Children().erase(it);
+      if (i < kJumpDepth) SetJump(s, i, nullptr);
+      break;
+    }
+    it->second->SubtractCount(1);
+    it->second->SubtractNodes(removed);
+    runner = it->second.get();
+    InvalidateCached(runner, false);
+  }
+  return true;
+}
+
+void PrefixTrie::EnableBloomFilter(std::size_t depth,
+                                   double false_positive_rate) {
+  if (depth == 0) {
+    bloom_.reset();
+    return;
+  }
+  bloom_ = std::make_unique<PrefixFilter>(depth, false_positive_rate, 0);
+  RebuildBloomFilter();
+}
+
+PrefixTrie::BloomFilterStats PrefixTrie::BloomStats() const noexcept {
+  BloomFilterStats stats;
+  if (!bloom_) return stats;
+  stats.depth = bloom_->depth;
+  stats.bits = bloom_->filter.Bits();
+  stats.hashes = bloom_->filter.Hashes();
+  stats.prefixes = bloom_->prefixes;
+  stats.estimated_false_positive_rate =
+      bloom_->filter.EstimatedFalsePositiveRate();
+  return stats;
+}
+
+void PrefixTrie::AddToBloomFilter(std::string_view s) {
+  if (s.size() < bloom_->depth) return;
+  const auto hash = std::hash<std::string_view>()(s.substr(0, bloom_->depth));
+  if (bloom_->filter.MayContain(hash)) return;
+  bloom_->filter.Add(hash);
+  if (++bloom_->prefixes <= bloom_->capacity) return;
+  // The prefix is already in the filter, so if growing it fails the update
+  // still succeeds, with a filter which is merely fuller than planned
+  try {
+    RebuildBloomFilter();
+  } catch (const std::bad_alloc&) {
+  }
+}
+
+void PrefixTrie::RebuildBloomFilter() {
+  // Collect the prefixes first to size the filter for them, with headroom
+  // for as many again before the next rebuild
+  const auto depth = bloom_->depth;
+  std::vector<std::size_t> hashes;
+  ForEachPathAt(root_.get(), "", depth, [&hashes](std::string_view path) {
+    hashes.push_back(std::hash<std::string_view>()(path));
+  });
+
+  constexpr std::size_t kMinCapacity = 1024;
+  const auto capacity = std::max(2 * hashes.size(), kMinCapacity);
+  bloom_ = std::make_unique<PrefixFilter>(
+      depth, bloom_->false_positive_rate, capacity);
+  for (const auto h : hashes) bloom_->filter.Add(h);
+  bloom_->prefixes = hashes.size();
+}
+
+void PrefixTrie::EnableKeyIndex(bool enable) {
+  if (!enable) {
+    keys_.reset();
+    return;
+  }
+  if (keys_) return;
+  keys_ = std::make_unique<KeySet<TrieNode>>();
+  ForEachKeyBelow(root_.get(), "", [this](const std::string& s, TrieNode* n) {
+    keys_->Insert(KeySet<TrieNode>::Hash(s), n);
+  });
+}
+
+void PrefixTrie::EnablePrefixCache(std::size_t capacity,
+                                   std::size_t max_results) {
+  ClearPrefixCache();
+  cache_.reset();
+  if (capacity == 0) return;
+  // Slots are stored in 32 bits in each node, one value marking no slot
+  capacity = std::min<std::size_t>(capacity, TrieNode::kNotCached);
+  cache_ = std::make_unique<PrefixCache>(capacity);
+  cache_->max_results = max_results;
+}
+
+void PrefixTrie::Clear() {
+  ClearPrefixCache();
+  root_ = MakeNode('\0', resource_);
+  RebuildJumpTable();
+  if (keys_) keys_->Clear();
+  if (bloom_) RebuildBloomFilter();
+}
+
+std::size_t PrefixTrie::CountPrefix(std::string_view s) const noexcept {
+  TrieMetricsScope metrics(TrieOp::kCountPrefix);
+  TrieNode* runner = FindNode(s);
+  return runner == nullptr ? 0 : runner->Count();
+}
+
+#ifdef PREFIX_TRIE_COROUTINES
+Generator<std::string_view> PrefixTrie::Matches(std::string prefix) const {
+  TrieNode* runner = FindNode(prefix);
+  if (runner == nullptr) co_return;
+
+  // Same traversal as MatchBelow, with the prefix doubling as the buffer
+  std::vector<std::pair<std::size_t, TrieNode*>> nodes;
+  for (const auto& n : runner->Children())
+    nodes.emplace_back(prefix.size(), n.second.get());
+  if (runner->IsTerminal()) co_yield prefix;
+  while (!nodes.empty()) {
+    auto tmp = nodes.back();
+    nodes.pop_back();
+    prefix.resize(tmp.first);
+    prefix.push_back(tmp.second->Key());
+    for (const auto& c : tmp.second->Children())
+      nodes.emplace_back(tmp.first + 1, c.second.get());
+    if (tmp.second->IsTerminal()) co_yield prefix;
+  }
+}
+#endif
+
+std::string PrefixTrie::KeyAt(std::size_t i) const {
+  TrieMetricsScope metrics(TrieOp::kKeyAt);
+  std::string key;
+  if (i >= Size()) return key;
+
+  TrieNode* runner = root_.get();
+  while (true) {
+    if (runner->IsTerminal()) {
+      if (i == 0) break;
+      --i;
+    }
+    // Skip whole subtrees of smaller siblings using their counts
+    for (const auto c : SortedChildren(runner)) {
+      if (i < c->Count()) {
+        CountNodeVisits(1);
+        runner = c;
+        key.push_back(c->Key());
+        break;
+      }
+      i -= c->Count();
+    }
+  }
+  return key;
+}
+
+std::size_t PrefixTrie::RankOf(std::string_view s) const noexcept {
+  TrieMetricsScope metrics(TrieOp::kRankOf);
+  return Rank(s);
+}
+
+std::size_t PrefixTrie::Rank(std::string_view s) const noexcept {
+  std::size_t rank = 0;
+  TrieNode* runner = root_.get();
+  for (const auto c : s) {
+    // Every string ending above the current depth is a proper prefix of s
+    if (runner->IsTerminal()) ++rank;
+    TrieNode* next = nullptr;
+    for (const auto& child : runner->Children()) {
+      if (static_cast<unsigned char>(child.first) <
+          static_cast<unsigned char>(c))
+        rank += child.second->Count();
+      else if (child.first == c)
+        next = child.second.get();
+    }
+    if (next == nullptr) break;
+    CountNodeVisits(1);
+    runner = next;
+  }
+  return rank;
+}
+
+bool PrefixTrie::Serialize(std::ostream& out) const {
+  std::string buf(kMagic, sizeof(kMagic) - 1);
+  PutVarint(buf, Size());
+  std::string previous;
+  MatchInOrder("", "", std::numeric_limits<std::size_t>::max(),
+               [&](const std::string& s) {
+                 std::size_t shared = 0;
+                 while (shared < previous.size() && shared < s.size() &&
+                        previous[shared] == s[shared])
+                   ++shared;
+                 PutVarint(buf, shared);
+                 PutVarint(buf, s.size() - shared);
+                 buf.append(s, shared, std::string::npos);
+                 previous = s;
+                 if (buf.size() >= kWriteChunk) {
+                   out.write(buf.data(), buf.size());
+                   buf.clear();
+                 }
+               });
+  out.write(buf.data(), buf.size());
+  out.flush();
+  return static_cast<bool>(out);
+}
+
+bool PrefixTrie::Deserialize(std::istream& in) {
+  char magic[sizeof(kMagic) - 1];
+  if (!in.read(magic, sizeof(magic)) ||
+      std::string_view(magic, sizeof(magic)) != kMagic)
+    return false;
+
+  std::uint64_t count;
+  if (!ReadVarint(in, count)) return false;
+  std::string key;
+  for (std::uint64_t i = 0; i < count; ++i) {
+    std::uint64_t shared, suffix;
+    if (!ReadVarint(in, shared) || !ReadVarint(in, suffix) ||
+        shared > key.size())
       return false;
-    runner = runner->Children()[s[cur_index]].get();
-    ++cur_index;
+    // Grow the key as its bytes arrive, so a corrupt length fails on the end
+    // of the stream rather than on allocating it up front
+    key.resize(shared);
+    while (suffix > 0) {
+      const auto n =
+          static_cast<std::size_t>(std::min<std::uint64_t>(suffix, kReadChunk));
+      const auto at = key.size();
+      key.resize(at + n);
+      if (!in.read(&key[at], static_cast<std::streamsize>(n))) return false;
+      suffix -= n;
+    }
+    Insert(key);
+  }
+  return true;
+}
+
+PrefixTrie::TrieNode* PrefixTrie::Child(const TrieNode* node,
+                                        std::string_view s,
+                                        std::size_t i) const noexcept {
+  CountNodeVisits(1);
+  const auto& entry = (*jump_)[static_cast<unsigned char>(s[0])];
+  if (i == 0) return entry.node;
+  if (i == 1) {
+    return entry.next ? (*entry.next)[static_cast<unsigned char>(s[1])]
+                      : nullptr;
+  }
+  auto it = node->Children().find(s[i]);
+  return it == node->Children().end() ? nullptr : it->second.get();
+}
+
+void PrefixTrie::SetJump(std::string_view s, std::size_t i, TrieNode* node) {
+  auto& entry = (*jump_)[static_cast<unsigned char>(s[0])];
+  if (i == 0) {
+    entry.node = node;
+    // Removing a first-level node removes everything below it
+    if (node == nullptr) entry.next.reset();
+    return;
+  }
+  if (!entry.next) entry.next = std::make_unique<JumpLevel>();
+  (*entry.next)[static_cast<unsigned char>(s[1])] = node;
+}
+
+void PrefixTrie::RebuildJumpTable() {
+  for (auto& entry : *jump_) {
+    entry.node = nullptr;
+    entry.next.reset();
   }
-  return cur_index == s.size();
+  for (const auto& c : root_->Children())
+    SetJumpBelow({&c.first, 1}, c.second.get());
+}
+
+void PrefixTrie::SetJumpBelow(std::string_view path, TrieNode* node) {
+  if (path.empty() || path.size() > kJumpDepth) return;
+  SetJump(path, path.size() - 1, node);
+  if (path.size() == kJumpDepth) return;
+  char key[kJumpDepth] = {path[0]};
+  for (const auto& c : node->Children()) {
+    key[1] = c.first;
+    SetJump({key, 2}, 1, c.second.get());
+  }
+}
+
+PrefixTrie::TrieNode* PrefixTrie::FindNode(std::string_view s) const noexcept {
+  if (bloom_ && s.size() >= bloom_->depth &&
+      !bloom_->filter.MayContain(
+          std::hash<std::string_view>()(s.substr(0, bloom_->depth))))
+    return nullptr;
+  TrieNode* runner = root_.get();
+  for (std::size_t i = 0; i < s.size(); ++i) {
+    runner = Child(runner, s, i);
+    if (runner == nullptr) return nullptr;
+  }
+  return runner;
+}
+
+PrefixTrie::TrieNode* PrefixTrie::CachedFindNode(
+    std::string_view s,
+    std::shared_ptr<const std::vector<std::string>>& results) const {
+  const auto stripe = cache_->StripeOf(s);
+  auto& cache = *cache_->stripes[stripe];
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    const auto slot = cache.entries.Find(s);
+    if (slot != ClockCache<CachedPrefix>::kNoSlot) {
+      results = cache.entries[slot].results;
+      return cache.entries[slot].node;
+    }
+  }
+
+  // Walk outside the lock. Missing prefixes are not cached since no node
+  // exists to invalidate them through
+  TrieNode* node = FindNode(s);
+  if (node == nullptr) return nullptr;
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  if (node->CacheSlot() == TrieNode::kNotCached) {
+    const auto slot = cache.entries.Insert(
+        s, CachedPrefix{node, nullptr}, [](CachedPrefix& e) {
+          e.node->SetCacheSlot(TrieNode::kNotCached);
+        });
+    node->SetCacheSlot(
+        static_cast<std::uint32_t>(cache_->offsets[stripe] + slot));
+  }
+  return node;
+}
+
+void PrefixTrie::CacheResults(
+    std::string_view s, TrieNode* node,
+    std::shared_ptr<const std::vector<std::string>> results) const {
+  const auto stripe = cache_->StripeOf(s);
+  auto& cache = *cache_->stripes[stripe];
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  // The entry may have been evicted by a concurrent reader meanwhile
+  if (node->CacheSlot() != TrieNode::kNotCached)
+    cache.entries[node->CacheSlot() - cache_->offsets[stripe]].results =
+        std::move(results);
+}
+
+void PrefixTrie::ClearPrefixCache() {
+  if (!cache_) return;
+  for (auto& cache : cache_->stripes) {
+    cache->entries.Clear([](CachedPrefix& e) {
+      e.node->SetCacheSlot(TrieNode::kNotCached);
+    });
+  }
+}
+
+void PrefixTrie::InvalidateCached(TrieNode* node, bool drop) noexcept {
+  // Updates exclude readers, so the cache is not locked here
+  if (node->CacheSlot() == TrieNode::kNotCached) return;
+  const auto stripe = cache_->StripeOfSlot(node->CacheSlot());
+  auto& entries = cache_->stripes[stripe]->entries;
+  const auto slot = node->CacheSlot() - cache_->offsets[stripe];
+  if (drop) {
+    entries.Erase(slot);
+    node->SetCacheSlot(TrieNode::kNotCached);
+  } else {
+    entries[slot].results.reset();
+  }
+}
+
+std::vector<PrefixTrie::TrieNode*> PrefixTrie::SortedChildren(
+    const TrieNode* node) {
+  std::vector<TrieNode*> children;
+  children.reserve(node->Children().size());
+  for (const auto& c : node->Children()) children.push_back(c.second.get());
+  std::sort(children.begin(), children.end(),
+            [](const TrieNode* a, const TrieNode* b) {
+              return static_cast<unsigned char>(a->Key()) <
+                     static_cast<unsigned char>(b->Key());
+            });
+  return children;
 }
@@ -1,33 +1,241 @@
 #ifndef PREFIX_TRIE_H__
 #define PREFIX_TRIE_H__
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <istream>
 #include <iterator>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <ostream>
 #include <set>
 #include <sstream>
 #include <stack>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
+
+#include "bloom_filter.h"
+#include "clock_cache.h"
+#include "key_set.h"
+#include "metrics.h"
+#ifdef PREFIX_TRIE_COROUTINES
+#include "generator.h"
+#endif
 
 class PrefixTrie {
  public:
-  PrefixTrie() : root_(std::make_unique<TrieNode>()) {}
+  PrefixTrie() : PrefixTrie(std::pmr::get_default_resource()) {}
+
+  /**
+   * Constructs a trie whose nodes and child maps are allocated from the given
+   * memory resource, e.g. a std::pmr::monotonic_buffer_resource or an arena
+   * in shared memory. The resource must outlive the trie, and any trie its
+   * nodes are moved into by Merge or GraftAt.
+   */
+  explicit PrefixTrie(std::pmr::memory_resource* resource)
+      : resource_(resource),
+        root_(MakeNode('\0', resource)),
+        jump_(std::make_unique<JumpTable>()) {}
+
+  /**
+   * Resource the trie allocates its nodes from.
+   */
+  std::pmr::memory_resource* Resource() const noexcept { return resource_; }
 
   /**
    * Inserts the string into the prefix trie. This method is idempotent.
+   * Returns false if the string was empty or already in the trie. If
+   * allocating a node throws, e.g. std::bad_alloc from a bounded memory
+   * resource, the exception propagates and the trie is left unchanged.
+   *
+   * All methods take keys and prefixes as std::string_view, so std::strings,
+   * C strings and (pointer, length) slices, e.g. Insert({buf, n}), are
+   * accepted without allocating a temporary std::string.
    */
-  void Insert(const std::string& s) noexcept;
+  bool Insert(std::string_view s);
 
   /**
    * Check if prefix trie contains string.
    */
-  bool Contains(const std::string& s) const noexcept;
+  bool Contains(std::string_view s) const noexcept;
+
+  /**
+   * Check if the exact string was inserted, rather than a longer string
+   * starting with it. Answered from the key index if it is enabled.
+   */
+  bool ContainsKey(std::string_view s) const noexcept;
+
+  /**
+   * Removes the string from the prefix trie, pruning nodes which no longer
+   * lead to any string. Returns false if the string was not in the trie.
+   */
+  bool Erase(std::string_view s) noexcept;
+
+  /**
+   * Removes every string. Enabled caches, indexes and filters stay enabled.
+   */
+  void Clear();
+
+  /**
+   * Number of strings in the trie which start with the given prefix. Runs in
+   * O(|prefix|) using the per-node subtree counts.
+   */
+  std::size_t CountPrefix(std::string_view s) const noexcept;
+
+  /**
+   * Returns the i-th string in lexicographic order, or the empty string if i
+   * is out of range. Runs in O(depth) child scans.
+   */
+  std::string KeyAt(std::size_t i) const;
+
+  /**
+   * Number of strings in the trie which are lexicographically smaller than the
+   * given string. The string itself need not be in the trie.
+   */
+  std::size_t RankOf(std::string_view s) const noexcept;
+
+  /**
+   * Returns a trie of the strings in either trie. Both tries are walked in
+   * lockstep and subtrees present in only one of them are copied wholesale.
+   */
+  static PrefixTrie Union(const PrefixTrie& a, const PrefixTrie& b);
+
+  /**
+   * Returns a trie of the strings in both tries. Subtrees missing from either
+   * trie are skipped without being visited.
+   */
+  static PrefixTrie Intersect(const PrefixTrie& a, const PrefixTrie& b);
+
+  /**
+   * Returns a trie of the strings in `a` which are not in `b`. Subtrees of
+   * `a` missing from `b` are copied wholesale.
+   */
+  static PrefixTrie Difference(const PrefixTrie& a, const PrefixTrie& b);
+
+  /**
+   * Adds the strings of the other trie, leaving it empty. Subtrees missing
+   * from this trie are moved over rather than copied, so only the nodes both
+   * tries share are visited. Moved nodes stay allocated from the other
+   * trie's resource.
+   */
+  void Merge(PrefixTrie&& other);
+
+  /**
+   * Removes every string starting with the prefix and returns them in a new
+   * trie. The subtree below the prefix is moved rather than copied, so this
+   * runs in O(|prefix|), plus the size of the subtree if the key index is
+   * enabled.
+   */
+  PrefixTrie ExtractPrefix(std::string_view prefix);
+
+  /**
+   * Adds the strings of the other trie, which must all start with the prefix
+   * (e.g. a trie returned by ExtractPrefix), leaving it empty. If this trie
+   * has no strings under the prefix, the other trie's subtree is moved into
+   * place in O(|prefix|), otherwise the tries are merged as by Merge. Returns
+   * false, leaving both tries untouched, if a string lacks the prefix.
+   */
+  bool GraftAt(std::string_view prefix, PrefixTrie&& other);
+
+  /**
+   * Writes the trie to the stream in the serialized trie format: a magic
+   * header, the number of strings, then the strings in lexicographic order,
+   * each front-coded as the length shared with the previous string followed by
+   * the remaining bytes. Returns false if writing failed.
+   */
+  bool Serialize(std::ostream& out) const;
+
+  /**
+   * Inserts the strings of a trie written by Serialize. Returns false if the
+   * input is malformed or truncated; strings read up to that point are kept.
+   */
+  bool Deserialize(std::istream& in);
+
+  /**
+   * Inserts every line of the file, as by LoadFromFd.
+   */
+  bool LoadFromFile(const std::string& path, unsigned threads = 1);
+
+  /**
+   * Inserts every newline-delimited line read from the file descriptor (a
+   * trailing carriage return is dropped). Regular files are mmapped and lines
+   * are inserted straight out of the mapping; pipes such as stdin are read
+   * through a large buffer. With more than one thread, a mapped file is built
+   * in parallel: each thread owns the strings whose first few bytes hash into
+   * its partition, with enough bytes that a prefix shared by the whole file
+   * does not land every string in one partition. Tries on a resource other
+   * than the global heap are built on one thread. Returns false on I/O
+   * errors.
+   */
+  bool LoadFromFd(int fd, unsigned threads = 1);
+
+  /**
+   * Number of strings in the trie.
+   */
+  std::size_t Size() const noexcept { return root_->Count(); }
+
+  /**
+   * Number of nodes in the trie, including the root.
+   */
+  std::size_t NodeCount() const noexcept { return root_->NodeCount(); }
+
+  /**
+   * Checks a blocked Bloom filter of every string's first `depth` bytes
+   * before walking the trie for a prefix of at least that length, so most
+   * lookups of absent prefixes cost a single cache line probe. The filter is
+   * sized for the given false-positive rate and rebuilt as it fills up. Erased
+   * strings stay in the filter until the next rebuild, which only costs
+   * precision. A depth of 0 removes the filter.
+   */
+  void EnableBloomFilter(std::size_t depth, double false_positive_rate = 0.01);
+
+  struct BloomFilterStats {
+    std::size_t depth = 0;
+    std::size_t bits = 0;
+    unsigned hashes = 0;
+    // Distinct prefixes added since the filter was last built
+    std::size_t prefixes = 0;
+    double estimated_false_positive_rate = 0;
+  };
+
+  /**
+   * Describes the Bloom filter, or returns zeros if it is not enabled.
+   */
+  BloomFilterStats BloomStats() const noexcept;
+
+  /**
+   * Maintains a hash index from every string to its terminal node next to the
+   * trie, so ContainsKey costs one hash probe instead of a dependent node
+   * access per character. The index takes 24 bytes per slot whatever the key
+   * length: a hash match is confirmed by the key length and a fingerprint
+   * under a random seed, so keys crafted to collide under std::hash are still
+   * told apart. Prefix queries still walk the trie. Disabling the index frees
+   * it.
+   */
+  void EnableKeyIndex(bool enable = true);
+
+  /**
+   * Puts a bounded CLOCK cache in front of MatchWithCallback, keyed by
+   * prefix. A cached prefix skips the walk to its node, and prefixes with at
+   * most `max_results` matches also keep their materialised matches. Insert
+   * and Erase invalidate exactly the cached prefixes of the string they
+   * modify. The cache is split by prefix hash into stripes with a mutex
+   * each, so const methods remain safe to call concurrently and readers of
+   * different prefixes rarely contend. A capacity of 0 removes the cache.
+   */
+  void EnablePrefixCache(std::size_t capacity, std::size_t max_results = 0);
 
   /**
    * Takes a prefix an iterator to a container in which the strings matching the
    * given prefix will be copied.
    */
   template <typename Container>
-  void MatchBackInserter(Container& c, const std::string& s) const noexcept {
+  void MatchBackInserter(Container& c, std::string_view s) const {
     auto bi = std::back_insert_iterator<Container>(c);
     MatchWithCallback(s, [&bi](const std::string& s) {
       *bi = s;
@@ -42,99 +250,548 @@ class PrefixTrie {
    * memory. Note the empty string prefix is always matched.
    */
   template <typename Callable>
-  void MatchWithCallback(const std::string& s, const Callable& callback) const {
+  void MatchWithCallback(std::string_view s, const Callable& callback) const {
+    TrieMetricsScope metrics(TrieOp::kMatch);
     // Check early exit conditions
-    if (s.empty())
-      callback("");
-    else if (root_->Children().find(s[0]) == root_->Children().end())
-      return;
+    if (s.empty()) callback("");
 
-    TrieNode* runner = root_->Children()[s[0]].get();
-    std::size_t cur_index = 1;
-
-    // Traverse trie to end of prefix
-    std::stringstream base;
-    while (cur_index < s.size()) {
-      base << runner->Key();
-      // If we can't move forward the prefix must not exist, exit early
-      if (runner->Children().find(s[cur_index]) == runner->Children().end())
-        return;
-      runner = runner->Children()[s[cur_index]].get();
-      ++cur_index;
+    // Traverse trie to end of prefix, or take the node and any materialised
+    // matches from the cache
+    std::shared_ptr<const std::vector<std::string>> results;
+    TrieNode* runner = cache_ ? CachedFindNode(s, results) : FindNode(s);
+    // If we can't move forward the prefix must not exist, exit early
+    if (runner == nullptr) return;
+    if (results) {
+      for (const auto& m : *results) callback(m);
+      return;
     }
-    base << runner->Key();
-
-    // Begin depth-first traversal over all strings who match the given prefix
-    std::stack<std::pair<std::size_t, TrieNode*>> nodes;
-    for (const auto& n : runner->Children()) {
-      nodes.push(std::make_pair(cur_index, n.second.get()));
+    if (cache_ && runner->Count() <= cache_->max_results &&
+        cache_->max_results > 0) {
+      auto matches = std::make_shared<std::vector<std::string>>();
+      matches->reserve(runner->Count());
+      MatchBelow(runner, s, [&matches](const std::string& m) {
+        matches->push_back(m);
+      });
+      CacheResults(s, runner, matches);
+      for (const auto& m : *matches) callback(m);
+      return;
     }
-    std::vector<char> postfix;
-    std::string prefix = base.str();
-    while (!nodes.empty()) {
-      auto tmp = nodes.top();
-      nodes.pop();
+    MatchBelow(runner, s, callback);
+  }
 
-      // Discard all postfix characters from most recent DFS that are beyond
-      // our current depth within the tree
-      while (prefix.size() + postfix.size() > tmp.first) postfix.pop_back();
+  enum class MatchOrder { kAny, kLexicographic };
 
-      postfix.push_back(tmp.second->Key());
+  /**
+   * Multi-threaded MatchWithCallback for prefixes with very many matches. The
+   * subtree below the prefix is split into independent child subtrees which
+   * `threads` workers take from per-thread queues, stealing from each other
+   * once their own queue runs dry.
+   *
+   * With kAny the callback is called concurrently from the workers, in no
+   * particular order, and must be thread-safe. With kLexicographic each
+   * subtree is buffered in order and the calling thread passes the buffers
+   * to the callback one after another; a single worker streams its matches
+   * without buffering. If the callback throws, no further subtrees are
+   * started and the first exception is rethrown once every worker has
+   * stopped. Unlike MatchWithCallback, the empty prefix itself is not
+   * reported as a match.
+   */
+  void ParallelMatch(std::string_view s,
+                     const std::function<void(const std::string&)>& callback,
+                     unsigned threads,
+                     MatchOrder order = MatchOrder::kAny) const;
 
-      if (tmp.second->IsLeaf()) {
-        // Construct full string since we are at a leaf node
-        std::stringstream p;
-        for (const auto c : postfix) {
-          p << c;
-        }
-        std::stringstream ss;
-        ss << prefix << p.str();
-
-        // String constructed, pass to callback
-        callback(ss.str());
-      } else {
-        // Add all children nodes to stack
-        for (const auto& c : tmp.second->Children()) {
-          nodes.push(std::make_pair(tmp.first + 1, c.second.get()));
-        }
-      }
-    }
+#ifdef PREFIX_TRIE_COROUTINES
+  /**
+   * Lazily yields the strings matching the given prefix, in the order of
+   * MatchWithCallback, from a coroutine suspended between matches:
+   *
+   *   for (std::string_view s : trie.Matches("pre")) ...
+   *
+   * Each view is valid until the generator is advanced, and the trie must
+   * not be modified while it is in use. Unlike MatchWithCallback, the empty
+   * prefix itself is not yielded. Requires building with
+   * PREFIX_TRIE_COROUTINES (C++20).
+   */
+  Generator<std::string_view> Matches(std::string prefix) const;
+#endif
+
+  /**
+   * Paginated variant of MatchWithCallback. Passes at most `limit` strings
+   * matching the given prefix which sort after `cursor` into the callback, in
+   * lexicographic order, and returns the cursor for the next page.
+   *
+   * The cursor is simply the last string passed to the callback, so it can be
+   * stored or sent to clients as is (it may contain arbitrary bytes). Start
+   * with an empty cursor; an empty cursor is returned once all matches have
+   * been passed. Resuming costs O(|cursor|) child scans rather than a rerun of
+   * all earlier pages. Unlike MatchWithCallback, the empty prefix itself is not
+   * reported as a match.
+   */
+  template <typename Callable>
+  std::string MatchFrom(std::string_view s, std::string_view cursor,
+                        std::size_t limit, const Callable& callback) const {
+    TrieMetricsScope metrics(TrieOp::kMatchFrom);
+    return MatchInOrder(s, cursor, limit, callback);
   }
 
  private:
+  friend class FrozenTrie;
+
+  class TrieNode;
+
+  /**
+   * Returns a node to the memory resource it was allocated from, which its
+   * child map remembers, so node pointers need not carry it.
+   */
+  struct NodeDeleter {
+    void operator()(TrieNode* node) const noexcept;
+  };
+  using NodePtr = std::unique_ptr<TrieNode, NodeDeleter>;
+  using ChildMap = std::pmr::unordered_map<char, NodePtr>;
+
   class TrieNode {
    public:
     /**
-     * Default constructor.
-     */
-    TrieNode() : TrieNode('\0') {}
-
-    /**
-     * Constructs a TrieNode with the given key.
+     * Constructs a TrieNode with the given key, whose child map allocates
+     * from the given resource.
      */
-    TrieNode(char k) : key_(k) {}
+    TrieNode(char k, std::pmr::memory_resource* resource)
+        : key_(k),
+          terminal_(false),
+          cache_slot_(kNotCached),
+          count_(0),
+          nodes_(1),
+          children_(resource) {}
 
-    // No copy-constructor since each TrieNode owns its children data
+    // No copy-constructor since each TrieNode owns its children data, and no
+    // move-constructor since the children are tied to one resource
     TrieNode(const TrieNode& o) = delete;
-    TrieNode(TrieNode&& o) : key_(o.key_) {
-      for (auto& p : o.children_) {
-        children_[p.first] = std::move(p.second);
-      }
+    TrieNode(TrieNode&& o) = delete;
+
+    std::pmr::memory_resource* Resource() const noexcept {
+      return children_.get_allocator().resource();
     }
 
     char Key() const noexcept { return key_; }
     bool IsLeaf() const noexcept { return children_.empty(); }
 
-    std::unordered_map<char, std::unique_ptr<TrieNode>>& Children() noexcept {
-      return children_;
-    }
+    /**
+     * A node is terminal when the path from the root to it spells an inserted
+     * string. Terminal nodes need not be leaves, e.g. "race" in "racecar".
+     */
+    bool IsTerminal() const noexcept { return terminal_; }
+    void SetTerminal(bool t) noexcept { terminal_ = t; }
+
+    /**
+     * Number of terminal nodes in the subtree rooted at this node, including
+     * the node itself.
+     */
+    std::size_t Count() const noexcept { return count_; }
+    void AddCount(std::size_t n) noexcept { count_ += n; }
+    void SubtractCount(std::size_t n) noexcept { count_ -= n; }
+
+    /**
+     * Number of nodes in the subtree rooted at this node, including the node
+     * itself, so subtrees can change owner without being traversed.
+     */
+    std::size_t NodeCount() const noexcept { return nodes_; }
+    void AddNodes(std::size_t n) noexcept { nodes_ += n; }
+    void SubtractNodes(std::size_t n) noexcept { nodes_ -= n; }
+
+    /**
+     * Slot of this node's prefix in the prefix cache, or kNotCached.
+     */
+    static constexpr std::uint32_t kNotCached = UINT32_MAX;
+    std::uint32_t CacheSlot() const noexcept { return cache_slot_; }
+    void SetCacheSlot(std::uint32_t slot) noexcept { cache_slot_ = slot; }
+
+    ChildMap& Children() noexcept { return children_; }
+    const ChildMap& Children() const noexcept { return children_; }
 
    private:
     char key_;
-    std::unordered_map<char, std::unique_ptr<TrieNode>> children_;
+    bool terminal_;
+    std::uint32_t cache_slot_;
+    std::size_t count_;
+    std::size_t nodes_;
+    ChildMap children_;
   };  // class TrieNode
-  std::unique_ptr<TrieNode> root_;
+
+  static NodePtr MakeNode(char key, std::pmr::memory_resource* resource) {
+    void* block = resource->allocate(sizeof(TrieNode), alignof(TrieNode));
+    return NodePtr(new (block) TrieNode(key, resource));
+  }
+
+  /**
+   * Ordered DFS frame used by MatchFrom.
+   */
+  struct MatchFrame {
+    TrieNode* node;
+    std::vector<TrieNode*> children;
+    std::size_t next;
+    std::size_t length;
+  };
+
+  /**
+   * Entry of the prefix cache. `results` is null until the matches are
+   * materialised and reset whenever a string under the prefix changes.
+   */
+  struct CachedPrefix {
+    TrieNode* node = nullptr;
+    std::shared_ptr<const std::vector<std::string>> results;
+  };
+
+  /**
+   * Prefix cache split into independently locked stripes, each its own CLOCK
+   * over an equal share of the capacity, with the remainder spread over the
+   * first stripes. A prefix always hashes to the same stripe, so the cache
+   * slot of its node is only touched under that stripe's lock; the slot
+   * number is global, stripe-major, starting at the stripe's offset.
+   */
+  struct PrefixCache {
+    static constexpr std::size_t kStripes = 16;
+
+    struct alignas(64) Stripe {
+      explicit Stripe(std::size_t capacity) : entries(capacity) {}
+
+      std::mutex mutex;
+      ClockCache<CachedPrefix> entries;
+    };
+
+    explicit PrefixCache(std::size_t capacity) {
+      const std::size_t n = std::min(capacity, kStripes);
+      for (std::size_t i = 0, offset = 0; i < n; ++i) {
+        const std::size_t size = capacity / n + (i < capacity % n ? 1 : 0);
+        offsets[i] = offset;
+        offset += size;
+        stripes.push_back(std::make_unique<Stripe>(size));
+      }
+    }
+
+    std::size_t StripeOf(std::string_view prefix) const noexcept {
+      return std::hash<std::string_view>()(prefix) % stripes.size();
+    }
+
+    /**
+     * Stripe holding the global slot: the last one starting at or before it.
+     */
+    std::size_t StripeOfSlot(std::size_t slot) const noexcept {
+      return std::upper_bound(offsets.begin(),
+                              offsets.begin() + stripes.size(), slot) -
+             offsets.begin() - 1;
+    }
+
+    // First global slot of each stripe
+    std::array<std::size_t, kStripes> offsets{};
+    std::vector<std::unique_ptr<Stripe>> stripes;
+    std::size_t max_results = 0;
+  };
+
+  struct PrefixFilter {
+    PrefixFilter(std::size_t d, double rate, std::size_t items)
+        : depth(d), false_positive_rate(rate), capacity(items),
+          filter(items, rate) {}
+
+    std::size_t depth;
+    double false_positive_rate;
+    // Prefixes the filter was sized for, and the number added so far
+    std::size_t capacity;
+    std::size_t prefixes = 0;
+    BloomFilter filter;
+  };
+
+  /**
+   * Adds the Bloom filter prefix of s, rebuilding the filter when it is full.
+   */
+  void AddToBloomFilter(std::string_view s);
+
+  /**
+   * Rebuilds the Bloom filter from the prefixes currently in the trie.
+   */
+  void RebuildBloomFilter();
+
+  /**
+   * Passes the path to every node `depth` levels deep in the subtree of the
+   * node, which is reached by `path`, into the callback. If the node itself
+   * is deeper, its path cut to `depth` bytes is passed instead.
+   */
+  template <typename Callable>
+  static void ForEachPathAt(const TrieNode* node, std::string_view path,
+                            std::size_t depth, const Callable& callback) {
+    if (path.size() >= depth) {
+      callback(path.substr(0, depth));
+      return;
+    }
+    std::vector<std::pair<std::size_t, const TrieNode*>> nodes;
+    for (const auto& c : node->Children())
+      nodes.emplace_back(path.size(), c.second.get());
+    std::string buf(path);
+    while (!nodes.empty()) {
+      auto tmp = nodes.back();
+      nodes.pop_back();
+      buf.resize(tmp.first);
+      buf.push_back(tmp.second->Key());
+      if (buf.size() == depth) {
+        callback(std::string_view(buf));
+        continue;
+      }
+      for (const auto& c : tmp.second->Children())
+        nodes.emplace_back(buf.size(), c.second.get());
+    }
+  }
+
+  /**
+   * MatchFrom without recording metrics, for operations built on it.
+   */
+  template <typename Callable>
+  std::string MatchInOrder(std::string_view s, std::string_view cursor,
+                           std::size_t limit, const Callable& callback) const {
+    if (limit == 0) return std::string(cursor);
+    TrieNode* runner = FindNode(s);
+    if (runner == nullptr) return "";
+    const std::size_t total = runner->Count();
+
+    // Position an ordered DFS stack just after the cursor. Each frame holds a
+    // node's children in order and the index of the next one to visit
+    std::vector<MatchFrame> path;
+    std::string buf(s);
+    std::size_t emitted = 0;
+    if (cursor.compare(0, s.size(), s) == 0) {
+      std::size_t cur_index = s.size();
+      CountNodeVisits(1);
+      path.push_back({runner, SortedChildren(runner), 0, cur_index});
+      for (; cur_index < cursor.size(); ++cur_index) {
+        auto& f = path.back();
+        const char key = cursor[cur_index];
+        runner = nullptr;
+        while (f.next < f.children.size() &&
+               static_cast<unsigned char>(f.children[f.next]->Key()) <=
+                   static_cast<unsigned char>(key)) {
+          if (f.children[f.next]->Key() == key) runner = f.children[f.next];
+          ++f.next;
+        }
+        if (runner == nullptr) break;
+        CountNodeVisits(1);
+        path.push_back({runner, SortedChildren(runner), 0, cur_index + 1});
+      }
+      buf.assign(cursor.substr(0, path.back().length));
+    } else if (cursor < s) {
+      if (runner->IsTerminal()) {
+        callback(buf);
+        ++emitted;
+      }
+      path.push_back({runner, SortedChildren(runner), 0, s.size()});
+    } else {
+      // Every match sorts before the cursor
+      return "";
+    }
+
+    while (!path.empty() && emitted < limit) {
+      auto& f = path.back();
+      if (f.next == f.children.size()) {
+        path.pop_back();
+        continue;
+      }
+      TrieNode* child = f.children[f.next++];
+      CountNodeVisits(1);
+      buf.resize(f.length);
+      buf.push_back(child->Key());
+      if (child->IsTerminal()) {
+        callback(buf);
+        ++emitted;
+      }
+      path.push_back({child, SortedChildren(child), 0, buf.size()});
+    }
+
+    // The subtree counts tell whether anything is left without looking ahead
+    if (emitted < limit) return "";
+    std::size_t seen = Rank(buf) - Rank(s) + 1;
+    return seen < total ? buf : "";
+  }
+
+  /**
+   * RankOf without recording metrics.
+   */
+  std::size_t Rank(std::string_view s) const noexcept;
+
+  /**
+   * Depth-first traversal passing every string below the node, which is
+   * reached by `prefix`, into the callback. The buffer is reused for every
+   * match.
+   */
+  template <typename Callable>
+  static void MatchBelow(TrieNode* runner, std::string_view prefix,
+                         const Callable& callback) {
+    ForEachKeyBelow(runner, prefix,
+                    [&callback](const std::string& s, TrieNode*) {
+                      callback(s);
+                    });
+  }
+
+  /**
+   * MatchBelow passing each string's terminal node along with it.
+   */
+  template <typename Callable>
+  static void ForEachKeyBelow(TrieNode* runner, std::string_view prefix,
+                              const Callable& callback) {
+    std::stack<std::pair<std::size_t, TrieNode*>> nodes;
+    for (const auto& n : runner->Children()) {
+      nodes.push(std::make_pair(prefix.size(), n.second.get()));
+    }
+    std::string buf(prefix);
+    if (runner->IsTerminal()) callback(buf, runner);
+    while (!nodes.empty()) {
+      auto tmp = nodes.top();
+      nodes.pop();
+      CountNodeVisits(1);
+
+      // Discard all characters from most recent DFS that are beyond our
+      // current depth within the tree
+      buf.resize(tmp.first);
+      buf.push_back(tmp.second->Key());
+
+      // String constructed, pass to callback
+      if (tmp.second->IsTerminal()) callback(buf, tmp.second);
+
+      // Add all children nodes to stack
+      for (const auto& c : tmp.second->Children()) {
+        nodes.push(std::make_pair(tmp.first + 1, c.second.get()));
+      }
+    }
+  }
+
+  /**
+   * The nodes at depths one and two are also reachable from a direct-indexed
+   * table keyed by the first two bytes, which replaces the two most frequent
+   * (and most cache-missed) child map lookups. The second level for a first
+   * byte is only allocated once a string continues past it.
+   */
+  static constexpr std::size_t kJumpDepth = 2;
+  using JumpLevel = std::array<TrieNode*, 256>;
+  struct JumpEntry {
+    TrieNode* node = nullptr;
+    std::unique_ptr<JumpLevel> next;
+  };
+  using JumpTable = std::array<JumpEntry, 256>;
+
+  /**
+   * Returns the child along s[i] of the node s[0, i) leads to, or nullptr.
+   */
+  TrieNode* Child(const TrieNode* node, std::string_view s,
+                  std::size_t i) const noexcept;
+
+  /**
+   * Points the jump table entry for s[0, i] (i < kJumpDepth) at the node.
+   */
+  void SetJump(std::string_view s, std::size_t i, TrieNode* node);
+
+  /**
+   * Points the jump table entries for the node, which `path` leads to, and
+   * for its children at them, if they are shallow enough to have entries.
+   */
+  void SetJumpBelow(std::string_view path, TrieNode* node);
+
+  /**
+   * Refills the jump table from the top two levels of the trie.
+   */
+  void RebuildJumpTable();
+
+  enum class SetOp { kUnion, kIntersect, kDifference };
+
+  /**
+   * Builds the root of the trie holding the result of the set operation on
+   * the subtrees rooted at `a` and `b` from the resource.
+   */
+  static NodePtr Combine(const TrieNode* a, const TrieNode* b, SetOp op,
+                         std::pmr::memory_resource* resource);
+
+  /**
+   * Returns a deep copy of the subtree allocated from the resource.
+   */
+  static NodePtr CopySubtree(const TrieNode* node,
+                             std::pmr::memory_resource* resource);
+
+  /**
+   * Returns the node reached by following the given prefix, or nullptr.
+   */
+  TrieNode* FindNode(std::string_view s) const noexcept;
+
+  /**
+   * FindNode through the prefix cache. Sets `results` to the materialised
+   * matches of the prefix if they are cached.
+   */
+  TrieNode* CachedFindNode(
+      std::string_view s,
+      std::shared_ptr<const std::vector<std::string>>& results) const;
+
+  /**
+   * Stores the matches below the node, which the prefix leads to, in its
+   * prefix cache entry, if any.
+   */
+  void CacheResults(
+      std::string_view s, TrieNode* node,
+      std::shared_ptr<const std::vector<std::string>> results) const;
+
+  /**
+   * Drops every prefix cache entry, e.g. before subtrees change owner.
+   */
+  void ClearPrefixCache();
+
+  /**
+   * Drops the materialised matches cached for the node's prefix, or the whole
+   * entry if the node is about to be destroyed.
+   */
+  void InvalidateCached(TrieNode* node, bool drop) noexcept;
+
+  /**
+   * Returns the children of the node ordered by unsigned character value, i.e.
+   * the order std::string compares in.
+   */
+  static std::vector<TrieNode*> SortedChildren(const TrieNode* node);
+
+  /**
+   * Moves the nodes of the other trie into this one, as Merge, leaving the
+   * other trie's root behind and the jump table and Bloom filter stale.
+   */
+  void MergeNodes(PrefixTrie& other);
+
+  /**
+   * Inserts every line of the buffer, see LoadFromFd.
+   */
+  void InsertLines(std::string_view data, unsigned threads);
+
+  /**
+   * Picks how many leading bytes of each line InsertLines partitions on, from
+   * a sample of the lines.
+   */
+  static std::size_t PartitionDepth(std::string_view data, unsigned threads);
+
+  // Lines sampled by PartitionDepth
+  static constexpr std::size_t kPartitionSamples = 1024;
+  // Distinct sampled prefixes per thread which end the search for a depth
+  static constexpr std::size_t kPartitionsPerThread = 16;
+  static constexpr std::size_t kMaxPartitionDepth = 64;
+  // At most one in this many lines may be shorter than the depth
+  static constexpr std::size_t kMaxShortLineShare = 8;
+
+  std::pmr::memory_resource* resource_;
+  NodePtr root_;
+  std::unique_ptr<JumpTable> jump_;
+  // Optional, see EnableBloomFilter
+  std::unique_ptr<PrefixFilter> bloom_;
+  // Optional, see EnableKeyIndex
+  std::unique_ptr<KeySet<TrieNode>> keys_;
+  // Optional, see EnablePrefixCache
+  std::unique_ptr<PrefixCache> cache_;
 
 };  // class PrefixTrie
 
+inline void PrefixTrie::NodeDeleter::operator()(
+    TrieNode* node) const noexcept {
+  std::pmr::memory_resource* resource = node->Resource();
+  node->~TrieNode();
+  resource->deallocate(node, sizeof(TrieNode), alignof(TrieNode));
+}
+
 #endif  // PREFIX_TRIE_H__
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "prefix_trie.h"
+
+namespace {
+
+constexpr std::size_t kReadBuffer = 1 << 20;
+// Bytes of a mapped file bucketed per thread at a time by a parallel load
+constexpr std::size_t kLoadWindow = 4 << 20;
+
+/**
+ * Moves the offset forward to the start of a line: returns the offset just
+ * past the first newline at or after pos - 1, or the size of the data.
+ */
+std::size_t LineEnd(std::string_view data, std::size_t pos) {
+  if (pos == 0 || pos >= data.size()) return std::min(pos, data.size());
+  const void* nl =
+      std::memchr(data.data() + pos - 1, '\n', data.size() - pos + 1);
+  return nl == nullptr ? data.size()
+                       : static_cast<const char*>(nl) - data.data() + 1;
+}
+
+/**
+ * Calls f on every line of the buffer without copying. Returns the number of
+ * bytes consumed, i.e. up to and including the last newline, or everything if
+ * `final` is set.
+ */
+template <typename F>
+std::size_t ForEachLine(std::string_view data, bool final, const F& f) {
+  std::size_t pos = 0;
+  while (pos < data.size()) {
+    const void* nl = std::memchr(data.data() + pos, '\n', data.size() - pos);
+    if (nl == nullptr && !final) break;
+    const std::size_t end = nl == nullptr
+                                ? data.size()
+                                : static_cast<const char*>(nl) - data.data();
+    auto line = data.substr(pos, end - pos);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    f(line);
+    pos = nl == nullptr ? end : end + 1;
+  }
+  return pos;
+}
+
+}  // namespace
+
+bool PrefixTrie::LoadFromFile(const std::string& path, unsigned threads) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  const bool ok = LoadFromFd(fd, threads);
+  ::close(fd);
+  return ok;
+}
+
+bool PrefixTrie::LoadFromFd(int fd, unsigned threads) {
+  struct stat st;
+  if (::fstat(fd, &st) != 0) return false;
+  if (S_ISREG(st.st_mode) && st.st_size > 0) {
+    const auto size = static_cast<std::size_t>(st.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      ::madvise(data, size, MADV_SEQUENTIAL);
+      InsertLines(std::string_view(static_cast<const char*>(data), size),
+                  threads);
+      ::munmap(data, size);
+      return true;
+    }
+  }
+
+  // Streams are read in large blocks; only a partial last line is moved to
+  // the front of the buffer before the next read
+  std::vector<char> buf(kReadBuffer);
+  std::size_t filled = 0;
+  while (true) {
+    if (filled == buf.size()) buf.resize(buf.size() * 2);
+    const auto n = ::read(fd, buf.data() + filled, buf.size() - filled);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return false;
+    filled += static_cast<std::size_t>(n);
+
+    const auto consumed =
+        ForEachLine(std::string_view(buf.data(), filled), n == 0,
+                    [this](std::string_view line) { Insert(line); });
+    std::memmove(buf.data(), buf.data() + consumed, filled - consumed);
+    filled -= consumed;
+    if (n == 0) return true;
+  }
+}
+
+void PrefixTrie::InsertLines(std::string_view data, unsigned threads) {
+  // Memory resources other than the global heap are generally not safe to
+  // allocate from on several threads at once
+  if (threads <= 1 || !resource_->is_equal(*std::pmr::new_delete_resource())) {
+    ForEachLine(data, true, [this](std::string_view line) { Insert(line); });
+    return;
+  }
+
+  // Lines are partitioned by a hash of their first `depth` bytes. Partitions
+  // then share only the nodes above that depth, so each thread builds its own
+  // in a private trie (with its own key index) and merging them back visits
+  // little more than the top levels. Shorter lines go straight into this trie
+  const std::size_t depth = PartitionDepth(data, threads);
+  const unsigned short_lines = threads;
+
+  // The parts do not see the prefix cache, so it is dropped wholesale
+  ClearPrefixCache();
+  std::vector<PrefixTrie> parts;
+  parts.reserve(threads);
+  for (unsigned t = 0; t < threads; ++t) {
+    parts.emplace_back(resource_);
+    if (keys_) parts.back().EnableKeyIndex();
+  }
+
+  // The data is loaded one window of kLoadWindow bytes per thread at a time,
+  // so only the lines of the current window are held in buckets. Within a
+  // window each thread scans one line-aligned chunk and buckets its lines by
+  // partition, then each thread inserts the lines of its own partition
+  std::vector<std::string_view> chunks(threads);
+  std::vector<std::vector<std::vector<std::string_view>>> buckets(
+      threads, std::vector<std::vector<std::string_view>>(threads + 1));
+  for (std::size_t window = 0; window < data.size();) {
+    const auto view = data.substr(
+        window, LineEnd(data, window + std::size_t{threads} * kLoadWindow) -
+                    window);
+    window += view.size();
+    for (std::size_t begin = 0, t = 0; t < threads; ++t) {
+      const auto end = std::max(
+          begin, LineEnd(view, view.size() * (t + 1) / threads));
+      chunks[t] = view.substr(begin, end - begin);
+      begin = end;
+    }
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+      workers.emplace_back([&chunks, &buckets, depth, short_lines, threads, t] {
+        ForEachLine(chunks[t], true, [&](std::string_view line) {
+          if (line.empty()) return;
+          const auto part =
+              line.size() < depth
+                  ? short_lines
+                  : static_cast<unsigned>(std::hash<std::string_view>()(
+                                              line.substr(0, depth)) %
+                                          threads);
+          buckets[t][part].push_back(line);
+        });
+      });
+    }
+    for (auto& w : workers) w.join();
+    workers.clear();
+
+    for (unsigned t = 0; t < threads; ++t) {
+      workers.emplace_back([&parts, &buckets, threads, t] {
+        for (unsigned from = 0; from < threads; ++from) {
+          for (const auto line : buckets[from][t]) parts[t].Insert(line);
+        }
+      });
+    }
+    // Short lines only touch nodes above the partition depth, which the parts
+    // build separately
+    for (unsigned from = 0; from < threads; ++from) {
+      for (const auto line : buckets[from][short_lines]) Insert(line);
+    }
+    for (auto& w : workers) w.join();
+    // Keep the bucket capacity for the next window
+    for (auto& from : buckets) {
+      for (auto& bucket : from) bucket.clear();
+    }
+  }
+
+  for (auto& part : parts) MergeNodes(part);
+  RebuildJumpTable();
+  if (bloom_) RebuildBloomFilter();
+}
+
+std::size_t PrefixTrie::PartitionDepth(std::string_view data,
+                                       unsigned threads) {
+  // Sample lines evenly across the data, so sorted input is sampled fairly
+  std::vector<std::string_view> samples;
+  for (std::size_t i = 0; i < kPartitionSamples; ++i) {
+    std::size_t pos = data.size() * i / kPartitionSamples;
+    if (pos > 0) {
+      const auto nl = data.find('\n', pos - 1);
+      if (nl == std::string_view::npos) break;
+      pos = nl + 1;
+    }
+    auto line = data.substr(pos, data.find('\n', pos) - pos);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    if (!line.empty()) samples.push_back(line);
+  }
+  if (samples.empty()) return 1;
+
+  // The shallowest depth with plenty of distinct prefixes per thread, short
+  // of sending too many lines down the serial path for short lines
+  std::size_t depth = 1;
+  for (; depth < kMaxPartitionDepth; ++depth) {
+    std::unordered_set<std::string_view> prefixes;
+    std::size_t shorter = 0;
+    for (const auto s : samples) {
+      if (s.size() < depth)
+        ++shorter;
+      else
+        prefixes.insert(s.substr(0, depth));
+    }
+    if (shorter * kMaxShortLineShare > samples.size())
+      return std::max<std::size_t>(depth - 1, 1);
+    if (prefixes.size() >= kPartitionsPerThread * threads) break;
+  }
+  return depth;
+}
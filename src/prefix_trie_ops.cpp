@@ -0,0 +1,337 @@
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "metrics.h"
+#include "prefix_trie.h"
+
+PrefixTrie PrefixTrie::Union(const PrefixTrie& a, const PrefixTrie& b) {
+  PrefixTrie result(a.resource_);
+  result.root_ = Combine(a.root_.get(), b.root_.get(), SetOp::kUnion,
+                         a.resource_);
+  result.RebuildJumpTable();
+  return result;
+}
+
+PrefixTrie PrefixTrie::Intersect(const PrefixTrie& a, const PrefixTrie& b) {
+  PrefixTrie result(a.resource_);
+  result.root_ = Combine(a.root_.get(), b.root_.get(), SetOp::kIntersect,
+                         a.resource_);
+  result.RebuildJumpTable();
+  return result;
+}
+
+PrefixTrie PrefixTrie::Difference(const PrefixTrie& a, const PrefixTrie& b) {
+  PrefixTrie result(a.resource_);
+  result.root_ = Combine(a.root_.get(), b.root_.get(), SetOp::kDifference,
+                         a.resource_);
+  result.RebuildJumpTable();
+  return result;
+}
+
+void PrefixTrie::Merge(PrefixTrie&& other) {
+  if (&other == this) return;
+  // Moved nodes must not keep slots of the other trie's cache, and cached
+  // matches here are about to go stale
+  other.ClearPrefixCache();
+  ClearPrefixCache();
+  MergeNodes(other);
+  RebuildJumpTable();
+  if (bloom_) RebuildBloomFilter();
+  other.Clear();
+}
+
+void PrefixTrie::MergeNodes(PrefixTrie& other) {
+  // Children only the other trie has are moved over when a node is first
+  // visited, along with their counts; the counts of shared nodes are
+  // recomputed once all their shared children are merged. The key index
+  // entries of moved nodes stay valid, while strings ending at a shared node
+  // are re-indexed under the node here
+  struct Frame {
+    TrieNode* mine;
+    TrieNode* theirs;
+    std::vector<std::pair<TrieNode*, TrieNode*>> shared;
+  };
+  std::string key;
+  auto make_frame = [this, &other, &key](TrieNode* mine, TrieNode* theirs) {
+    Frame f{mine, theirs, {}};
+    for (auto& c : theirs->Children()) {
+      auto& child = mine->Children()[c.first];
+      if (child) {
+        f.shared.emplace_back(child.get(), c.second.get());
+        continue;
+      }
+      child = std::move(c.second);
+      if (keys_ && !other.keys_) {
+        key.push_back(c.first);
+        ForEachKeyBelow(child.get(), key,
+                        [this](const std::string& s, TrieNode* n) {
+                          keys_->Insert(KeySet<TrieNode>::Hash(s), n);
+                        });
+        key.pop_back();
+      }
+    }
+    return f;
+  };
+
+  std::vector<Frame> path;
+  path.push_back(make_frame(root_.get(), other.root_.get()));
+  while (!path.empty()) {
+    auto& f = path.back();
+    if (!f.shared.empty()) {
+      const auto next = f.shared.back();
+      f.shared.pop_back();
+      key.push_back(next.first->Key());
+      path.push_back(make_frame(next.first, next.second));
+      continue;
+    }
+    TrieNode* node = f.mine;
+    if (keys_ && f.theirs->IsTerminal()) {
+      const auto hash = KeySet<TrieNode>::Hash(key);
+      if (other.keys_) other.keys_->Erase(hash, f.theirs);
+      if (!node->IsTerminal()) keys_->Insert(hash, node);
+    }
+    node->SetTerminal(node->IsTerminal() || f.theirs->IsTerminal());
+    std::size_t count = node->IsTerminal() ? 1 : 0;
+    std::size_t nodes = 1;
+    for (const auto& c : node->Children()) {
+      count += c.second->Count();
+      nodes += c.second->NodeCount();
+    }
+    node->SubtractCount(node->Count());
+    node->AddCount(count);
+    node->SubtractNodes(node->NodeCount());
+    node->AddNodes(nodes);
+    path.pop_back();
+    if (!path.empty()) key.pop_back();
+  }
+  if (keys_ && other.keys_) {
+    other.keys_->ForEach(
+        [this](const KeySet<TrieNode>::Key& key, TrieNode* n) {
+          keys_->Insert(key, n);
+        });
+  }
+}
+
+PrefixTrie PrefixTrie::ExtractPrefix(std::string_view prefix) {
+  PrefixTrie result(resource_);
+  TrieNode* node = FindNode(prefix);
+  if (node == nullptr || node->Count() == 0) return result;
+  // Cached nodes below the prefix change owner
+  ClearPrefixCache();
+  if (keys_) {
+    ForEachKeyBelow(node, prefix, [this](const std::string& s, TrieNode* n) {
+      keys_->Erase(KeySet<TrieNode>::Hash(s), n);
+    });
+  }
+  if (prefix.empty()) {
+    std::swap(root_, result.root_);
+    std::swap(jump_, result.jump_);
+    if (bloom_) RebuildBloomFilter();
+    return result;
+  }
+
+  // The path to the subtree, from the root to its parent. From the first
+  // node on it which leads only to the subtree, the rest of the path is
+  // dropped along with the subtree
+  const auto count = node->Count();
+  const auto nodes = node->NodeCount();
+  std::vector<TrieNode*> path{root_.get()};
+  for (std::size_t i = 0; i + 1 < prefix.size(); ++i)
+    path.push_back(Child(path.back(), prefix, i));
+  std::size_t cut = 1;
+  while (cut < path.size() && path[cut]->Count() != count) ++cut;
+
+  // Detach the subtree, then take its strings and nodes off the counts along
+  // the path. Erased strings stay in the Bloom filter, as for Erase
+  auto it = path.back()->Children().find(prefix.back());
+  auto subtree = std::move(it->second);
+  path.back()->Children().erase(it);
+  if (prefix.size() <= kJumpDepth) SetJump(prefix, prefix.size() - 1, nullptr);
+  const auto dropped = nodes + (path.size() - cut);
+  for (std::size_t i = 0; i < cut; ++i) {
+    path[i]->SubtractCount(count);
+    path[i]->SubtractNodes(dropped);
+  }
+  if (cut < path.size()) {
+    path[cut - 1]->Children().erase(prefix[cut - 1]);
+    if (cut - 1 < kJumpDepth) SetJump(prefix, cut - 1, nullptr);
+  }
+
+  // Rebuild the path to the subtree in the result
+  TrieNode* tail = result.root_.get();
+  tail->AddCount(count);
+  tail->AddNodes(prefix.size() - 1 + nodes);
+  CountNodeAllocations(prefix.size() - 1);
+  for (std::size_t i = 0; i + 1 < prefix.size(); ++i) {
+    auto& child = tail->Children()[prefix[i]];
+    child = MakeNode(prefix[i], resource_);
+    child->AddCount(count);
+    child->AddNodes(prefix.size() - 2 - i + nodes);
+    tail = child.get();
+  }
+  tail->Children()[prefix.back()] = std::move(subtree);
+  result.RebuildJumpTable();
+  return result;
+}
+
+bool PrefixTrie::GraftAt(std::string_view prefix, PrefixTrie&& other) {
+  if (&other == this) return false;
+  // Every string of the other trie must start with the prefix
+  const TrieNode* below = other.FindNode(prefix);
+  if ((below == nullptr ? 0 : below->Count()) != other.Size()) return false;
+  if (other.Size() == 0) return true;
+  if (FindNode(prefix) != nullptr) {
+    Merge(std::move(other));
+    return true;
+  }
+
+  // Find where the path to the prefix leaves this trie. The other trie's
+  // path to the prefix is a chain, so its subtree at that depth holds all of
+  // its strings
+  std::size_t depth = 0;
+  TrieNode* runner = root_.get();
+  while (TrieNode* next = Child(runner, prefix, depth)) {
+    runner = next;
+    ++depth;
+  }
+  other.ClearPrefixCache();
+  TrieNode* their_parent = other.FindNode(prefix.substr(0, depth));
+  auto it = their_parent->Children().find(prefix[depth]);
+  auto subtree = std::move(it->second);
+  their_parent->Children().erase(it);
+
+  const auto count = subtree->Count();
+  const auto nodes = subtree->NodeCount();
+  runner = root_.get();
+  runner->AddCount(count);
+  runner->AddNodes(nodes);
+  InvalidateCached(runner, false);
+  for (std::size_t i = 0; i < depth; ++i) {
+    runner = Child(runner, prefix, i);
+    runner->AddCount(count);
+    runner->AddNodes(nodes);
+    InvalidateCached(runner, false);
+  }
+  TrieNode* node = subtree.get();
+  runner->Children()[prefix[depth]] = std::move(subtree);
+  SetJumpBelow(prefix.substr(0, depth + 1), node);
+
+  if (keys_) {
+    ForEachKeyBelow(node, prefix.substr(0, depth + 1),
+                    [this](const std::string& s, TrieNode* n) {
+                      keys_->Insert(KeySet<TrieNode>::Hash(s), n);
+                    });
+  }
+  if (bloom_) {
+    ForEachPathAt(node, prefix.substr(0, depth + 1), bloom_->depth,
+                  [this](std::string_view path) { AddToBloomFilter(path); });
+  }
+  other.Clear();
+  return true;
+}
+
+PrefixTrie::NodePtr PrefixTrie::Combine(const TrieNode* a, const TrieNode* b,
+                                        SetOp op,
+                                        std::pmr::memory_resource* resource) {
+  // Each frame holds the node being built for a pair of nodes with the same
+  // path, and the child pairs still to combine. A child missing from one side
+  // is either copied whole or skipped, depending on the operation
+  struct Frame {
+    const TrieNode* a;
+    const TrieNode* b;
+    NodePtr out;
+    std::vector<std::pair<const TrieNode*, const TrieNode*>> pending;
+  };
+  auto make_frame = [op, resource](const TrieNode* x, const TrieNode* y) {
+    CountNodeAllocations(1);
+    Frame f{x, y, MakeNode(x->Key(), resource), {}};
+    for (const auto& c : x->Children()) {
+      auto it = y->Children().find(c.first);
+      const TrieNode* match =
+          it == y->Children().end() ? nullptr : it->second.get();
+      if (match != nullptr || op != SetOp::kIntersect)
+        f.pending.emplace_back(c.second.get(), match);
+    }
+    if (op == SetOp::kUnion) {
+      for (const auto& c : y->Children()) {
+        if (x->Children().find(c.first) == x->Children().end())
+          f.pending.emplace_back(nullptr, c.second.get());
+      }
+    }
+    return f;
+  };
+
+  std::vector<Frame> path;
+  path.push_back(make_frame(a, b));
+  while (true) {
+    auto& f = path.back();
+    if (!f.pending.empty()) {
+      const auto next = f.pending.back();
+      f.pending.pop_back();
+      if (next.first != nullptr && next.second != nullptr) {
+        path.push_back(make_frame(next.first, next.second));
+        continue;
+      }
+      auto copy = CopySubtree(next.first != nullptr ? next.first : next.second,
+                              resource);
+      f.out->AddCount(copy->Count());
+      f.out->AddNodes(copy->NodeCount());
+      f.out->Children()[copy->Key()] = std::move(copy);
+      continue;
+    }
+
+    bool terminal;
+    switch (op) {
+      case SetOp::kUnion:
+        terminal = f.a->IsTerminal() || f.b->IsTerminal();
+        break;
+      case SetOp::kIntersect:
+        terminal = f.a->IsTerminal() && f.b->IsTerminal();
+        break;
+      default:
+        terminal = f.a->IsTerminal() && !f.b->IsTerminal();
+    }
+    f.out->SetTerminal(terminal);
+    if (terminal) f.out->AddCount(1);
+    auto done = std::move(f.out);
+    path.pop_back();
+    if (path.empty()) return done;
+
+    // A node without strings below it has no children attached either
+    if (done->Count() == 0) continue;
+    auto& parent = path.back().out;
+    parent->AddCount(done->Count());
+    parent->AddNodes(done->NodeCount());
+    parent->Children()[done->Key()] = std::move(done);
+  }
+}
+
+PrefixTrie::NodePtr PrefixTrie::CopySubtree(
+    const TrieNode* node, std::pmr::memory_resource* resource) {
+  auto copy_node = [resource](const TrieNode* from) {
+    auto to = MakeNode(from->Key(), resource);
+    to->SetTerminal(from->IsTerminal());
+    to->AddCount(from->Count());
+    to->AddNodes(from->NodeCount() - 1);
+    CountNodeAllocations(1);
+    return to;
+  };
+  auto root = copy_node(node);
+  std::vector<std::pair<const TrieNode*, TrieNode*>> stack;
+  stack.emplace_back(node, root.get());
+  while (!stack.empty()) {
+    const auto tmp = stack.back();
+    stack.pop_back();
+    for (const auto& c : tmp.first->Children()) {
+      auto copy = copy_node(c.second.get());
+      stack.emplace_back(c.second.get(), copy.get());
+      tmp.second->Children()[c.first] = std::move(copy);
+    }
+  }
+  return root;
+}
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "prefix_trie.h"
+
+namespace {
+
+// Subtrees per worker to split into, so stealing can even out skew
+constexpr std::size_t kTasksPerThread = 16;
+// Subtrees with fewer strings are not worth splitting further
+constexpr std::size_t kMinTaskStrings = 1024;
+
+/**
+ * Per-worker task queues. Owners take tasks from the front, in task order,
+ * and thieves from the back, so ordered output is rarely held up.
+ */
+class TaskQueues {
+ public:
+  explicit TaskQueues(unsigned workers) : queues_(workers) {}
+
+  void Push(unsigned worker, std::size_t task) {
+    std::lock_guard<std::mutex> lock(queues_[worker].mutex);
+    queues_[worker].tasks.push_back(task);
+  }
+
+  bool Pop(unsigned worker, std::size_t& task) {
+    for (std::size_t i = 0; i < queues_.size(); ++i) {
+      auto& q = queues_[(worker + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (q.tasks.empty()) continue;
+      if (i == 0) {
+        task = q.tasks.front();
+        q.tasks.pop_front();
+      } else {
+        task = q.tasks.back();
+        q.tasks.pop_back();
+      }
+      return true;
+    }
+    return false;
+  }
+
+ private:
+  struct alignas(64) Queue {
+    std::mutex mutex;
+    std::deque<std::size_t> tasks;
+  };
+
+  std::vector<Queue> queues_;
+};  // class TaskQueues
+
+}  // namespace
+
+void PrefixTrie::ParallelMatch(
+    std::string_view s, const std::function<void(const std::string&)>& callback,
+    unsigned threads, MatchOrder order) const {
+  TrieMetricsScope metrics(TrieOp::kParallelMatch);
+  TrieNode* runner = FindNode(s);
+  if (runner == nullptr) return;
+  threads = std::max(threads, 1u);
+
+  // Split the subtree into tasks in lexicographic order by repeatedly
+  // replacing the largest subtree by the string at its root, if any, and its
+  // child subtrees
+  struct Task {
+    std::string path;
+    TrieNode* node;
+    // Whether the task is the whole subtree or only the string at its root
+    bool subtree;
+  };
+  std::vector<Task> tasks{{std::string(s), runner, true}};
+  const std::size_t target = threads * kTasksPerThread;
+  while (threads > 1 && tasks.size() < target) {
+    auto largest = tasks.end();
+    for (auto it = tasks.begin(); it != tasks.end(); ++it) {
+      if (!it->subtree || it->node->IsLeaf()) continue;
+      if (largest == tasks.end() || it->node->Count() > largest->node->Count())
+        largest = it;
+    }
+    if (largest == tasks.end() || largest->node->Count() < kMinTaskStrings)
+      break;
+
+    std::vector<Task> split;
+    if (largest->node->IsTerminal())
+      split.push_back({largest->path, largest->node, false});
+    for (TrieNode* c : SortedChildren(largest->node))
+      split.push_back({largest->path + c->Key(), c, true});
+    const auto at = largest - tasks.begin();
+    tasks.erase(largest);
+    tasks.insert(tasks.begin() + at, split.begin(), split.end());
+  }
+
+  const bool ordered = order == MatchOrder::kLexicographic;
+  auto match = [&](const Task& task, const auto& f) {
+    if (!task.subtree)
+      f(task.path);
+    else if (ordered)
+      MatchInOrder(task.path, "", std::numeric_limits<std::size_t>::max(), f);
+    else
+      MatchBelow(task.node, task.path, f);
+  };
+  // With a single task in flight at a time there is no order to restore, so
+  // matches stream straight into the callback
+  if (threads == 1 || tasks.size() == 1) {
+    for (const auto& task : tasks) match(task, callback);
+    return;
+  }
+
+  std::vector<std::vector<std::string>> buffers(ordered ? tasks.size() : 0);
+  auto run = [&](std::size_t i) {
+    if (!ordered) {
+      match(tasks[i], callback);
+      return;
+    }
+    auto& out = buffers[i];
+    match(tasks[i], [&out](const std::string& m) { out.push_back(m); });
+  };
+
+  TaskQueues queues(threads);
+  for (std::size_t i = 0; i < tasks.size(); ++i)
+    queues.Push(static_cast<unsigned>(i % threads), i);
+
+  // Finished buffers are handed to the calling thread in task order. The
+  // first exception thrown by a task stops the workers taking new ones and is
+  // rethrown on the calling thread once they are joined
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+  std::vector<char> done(tasks.size(), 0);
+  std::atomic<bool> stop{false};
+  std::exception_ptr error;
+  // Node visits are counted per thread, so the workers' are handed to the
+  // calling thread for the metrics of the whole match
+  std::atomic<std::uint64_t> worker_visits{0};
+  auto work = [&](unsigned worker) {
+    const auto visits = NodeVisits();
+    std::size_t i;
+    while (!stop.load(std::memory_order_relaxed) && queues.Pop(worker, i)) {
+      try {
+        run(i);
+      } catch (...) {
+        {
+          std::lock_guard<std::mutex> lock(done_mutex);
+          if (!error) error = std::current_exception();
+          stop.store(true, std::memory_order_relaxed);
+        }
+        done_cv.notify_all();
+        break;
+      }
+      if (ordered) {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        done[i] = 1;
+        done_cv.notify_one();
+      }
+    }
+    // Worker 0 is the calling thread itself unless the match is ordered
+    if (kMetricsEnabled && (ordered || worker != 0))
+      worker_visits.fetch_add(NodeVisits() - visits,
+                              std::memory_order_relaxed);
+  };
+
+  // Stops and joins the workers on every way out of the block below, also
+  // when the callback throws on the calling thread
+  struct Joiner {
+    std::atomic<bool>& stop;
+    std::vector<std::thread>& workers;
+
+    ~Joiner() {
+      stop.store(true, std::memory_order_relaxed);
+      for (auto& w : workers) w.join();
+    }
+  };
+  std::vector<std::thread> workers;
+  {
+    Joiner joiner{stop, workers};
+    // Without ordering the calling thread is a worker too
+    for (unsigned w = ordered ? 0 : 1; w < threads; ++w)
+      workers.emplace_back(work, w);
+    if (!ordered) {
+      work(0);
+    } else {
+      for (std::size_t i = 0; i < tasks.size(); ++i) {
+        {
+          std::unique_lock<std::mutex> lock(done_mutex);
+          done_cv.wait(lock, [&done, &stop, i] {
+            return done[i] != 0 || stop.load(std::memory_order_relaxed);
+          });
+          if (done[i] == 0) break;
+        }
+        for (const auto& m : buffers[i]) callback(m);
+        std::vector<std::string>().swap(buffers[i]);
+      }
+    }
+  }
+  if (error) std::rethrow_exception(error);
+  CountNodeVisits(worker_visits.load(std::memory_order_relaxed));
+}
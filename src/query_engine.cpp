@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "prefix_trie.h"
+#include "query_engine.h"
+
+namespace {
+
+/**
+ * CPUs this process may run on, from its affinity mask, or every hardware
+ * thread where the mask is not available.
+ */
+std::vector<unsigned> AllowedCpus() {
+  std::vector<unsigned> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+  }
+#endif
+  if (cpus.empty()) {
+    const unsigned n = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned cpu = 0; cpu < n; ++cpu) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+void PinToCpu(std::thread& thread, unsigned cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  // Best effort, e.g. the CPU may be outside this process's cpuset
+  pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+  (void)thread;
+  (void)cpu;
+#endif
+}
+
+}  // namespace
+
+QueryEngine::QueryEngine(const PrefixTrie& trie)
+    : QueryEngine(trie, Options()) {}
+
+QueryEngine::QueryEngine(const PrefixTrie& trie, const Options& options)
+    : trie_(trie),
+      max_batch_(std::max<std::size_t>(options.max_batch, 1)),
+      queue_(options.queue_capacity),
+      stopping_(false),
+      sleeping_(0),
+      waiting_(0) {
+  const auto cpus = AllowedCpus();
+  const auto workers = options.workers == 0
+                           ? static_cast<unsigned>(cpus.size())
+                           : options.workers;
+  for (unsigned i = 0; i < workers; ++i) {
+    workers_.emplace_back(&QueryEngine::Work, this);
+    if (options.pin_workers) PinToCpu(workers_.back(), cpus[i % cpus.size()]);
+  }
+}
+
+QueryEngine::~QueryEngine() {
+  stopping_.store(true);
+  {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+  }
+  idle_.notify_all();
+  for (auto& w : workers_) w.join();
+}
+
+void QueryEngine::Contains(std::string s, std::function<void(bool)> done) {
+  Query query{std::move(s), std::move(done), nullptr};
+  Submit(query);
+}
+
+std::future<bool> QueryEngine::Contains(std::string s) {
+  auto promise = std::make_shared<std::promise<bool>>();
+  auto future = promise->get_future();
+  Contains(std::move(s), [promise](bool found) { promise->set_value(found); });
+  return future;
+}
+
+void QueryEngine::Match(std::string s,
+                        std::function<void(std::vector<std::string>)> done) {
+  Query query{std::move(s), nullptr, std::move(done)};
+  Submit(query);
+}
+
+std::future<std::vector<std::string>> QueryEngine::Match(std::string s) {
+  auto promise = std::make_shared<std::promise<std::vector<std::string>>>();
+  auto future = promise->get_future();
+  Match(std::move(s), [promise](std::vector<std::string> matches) {
+    promise->set_value(std::move(matches));
+  });
+  return future;
+}
+
+void QueryEngine::Submit(Query& query) {
+  // A full queue means the workers are saturated; sleep until one of them
+  // takes a batch, with the same handshake as idle workers use in Work
+  if (!queue_.TryPush(query)) {
+    std::unique_lock<std::mutex> lock(room_mutex_);
+    waiting_.fetch_add(1);
+    while (true) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (queue_.TryPush(query)) break;
+      room_.wait(lock);
+    }
+    waiting_.fetch_sub(1);
+  }
+  // Pairs with the fence after the increment of sleeping_ in Work: either the
+  // worker's re-check of the queue sees the query or this thread sees the
+  // sleeping worker, so a worker never sleeps on a query
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load() > 0) {
+    {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+    }
+    idle_.notify_one();
+  }
+}
+
+void QueryEngine::Work() {
+  std::vector<Query> batch;
+  Query query;
+  while (true) {
+    while (batch.size() < max_batch_ && queue_.TryPop(query))
+      batch.push_back(std::move(query));
+
+    if (batch.empty()) {
+      if (stopping_.load()) return;
+      // The mutex is held from announcing the sleep until waiting, so a
+      // submitter which sees the announcement notifies after the wait starts
+      std::unique_lock<std::mutex> lock(idle_mutex_);
+      sleeping_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (queue_.TryPop(query)) {
+        batch.push_back(std::move(query));
+      } else if (!stopping_.load()) {
+        idle_.wait(lock);
+      }
+      sleeping_.fetch_sub(1);
+      continue;
+    }
+
+    // Pairs with the fence before a waiting submitter's retry: either the
+    // retry sees the room made by this batch or this thread sees the waiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_.load() > 0) {
+      {
+        std::lock_guard<std::mutex> lock(room_mutex_);
+      }
+      room_.notify_all();
+    }
+
+    // Queries for nearby keys share the top of their paths through the trie
+    std::sort(batch.begin(), batch.end(),
+              [](const Query& a, const Query& b) { return a.key < b.key; });
+    for (auto& q : batch) Answer(q);
+    batch.clear();
+  }
+}
+
+void QueryEngine::Answer(Query& query) const {
+  if (query.contains) {
+    query.contains(trie_.Contains(query.key));
+    return;
+  }
+  std::vector<std::string> matches;
+  trie_.MatchBackInserter(matches, query.key);
+  query.match(std::move(matches));
+}
@@ -0,0 +1,96 @@
+#ifndef QUERY_ENGINE_H__
+#define QUERY_ENGINE_H__
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mpmc_queue.h"
+
+class PrefixTrie;
+
+/**
+ * Asynchronous front-end answering Contains and prefix match queries against
+ * a PrefixTrie on a pool of worker threads. Queries are submitted to a
+ * lock-free queue; each worker takes a batch, sorts it by key so queries
+ * sharing a prefix walk the same nodes back to back while they are cached,
+ * and completes the batch's callbacks or futures.
+ *
+ * The trie must outlive the engine and must not be modified while queries
+ * are pending. Callbacks run on worker threads and should be short.
+ */
+class QueryEngine {
+ public:
+  struct Options {
+    // Worker threads; 0 uses one per CPU in the process's affinity mask
+    unsigned workers = 0;
+    // Queued queries before submitting blocks until a worker makes room
+    std::size_t queue_capacity = 1 << 14;
+    // Queries a worker takes from the queue at once
+    std::size_t max_batch = 64;
+    // Whether workers are pinned to one CPU of the affinity mask each
+    bool pin_workers = true;
+  };
+
+  explicit QueryEngine(const PrefixTrie& trie);
+  QueryEngine(const PrefixTrie& trie, const Options& options);
+
+  /**
+   * Answers every query already submitted, then stops the workers.
+   */
+  ~QueryEngine();
+
+  QueryEngine(const QueryEngine& o) = delete;
+  QueryEngine& operator=(const QueryEngine& o) = delete;
+
+  /**
+   * Queues a Contains query; `done` is called with the answer. Blocks,
+   * without spinning, while the queue is full.
+   */
+  void Contains(std::string s, std::function<void(bool)> done);
+  std::future<bool> Contains(std::string s);
+
+  /**
+   * Queues a prefix match; `done` is called with the matching strings, in
+   * no particular order. Blocks like Contains while the queue is full.
+   */
+  void Match(std::string s,
+             std::function<void(std::vector<std::string>)> done);
+  std::future<std::vector<std::string>> Match(std::string s);
+
+ private:
+  struct Query {
+    std::string key;
+    // Exactly one of the two is set
+    std::function<void(bool)> contains;
+    std::function<void(std::vector<std::string>)> match;
+  };
+
+  void Submit(Query& query);
+  void Work();
+  void Answer(Query& query) const;
+
+  const PrefixTrie& trie_;
+  std::size_t max_batch_;
+  MpmcQueue<Query> queue_;
+  std::vector<std::thread> workers_;
+  std::atomic<bool> stopping_;
+
+  // Idle workers sleep here; submitters only take the mutex if one does
+  std::mutex idle_mutex_;
+  std::condition_variable idle_;
+  std::atomic<unsigned> sleeping_;
+
+  // Submitters finding the queue full sleep here until a worker takes a
+  // batch; workers only take the mutex if one does
+  std::mutex room_mutex_;
+  std::condition_variable room_;
+  std::atomic<unsigned> waiting_;
+};  // class QueryEngine
+
+#endif  // QUERY_ENGINE_H__
@@ -0,0 +1,96 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+#ifdef PREFIX_TRIE_NUMA
+#include <numa.h>
+#endif
+
+#include "frozen_trie.h"
+#include "prefix_trie.h"
+#include "replicated_frozen_trie.h"
+
+/**
+ * Memory resource allocating pages bound to one NUMA node. Each allocation is
+ * a separate mapping, which suits the few large arrays of a FrozenTrie.
+ */
+class ReplicatedFrozenTrie::NodeResource : public std::pmr::memory_resource {
+ public:
+  explicit NodeResource(int node) noexcept : node_(node) {}
+
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t) override {
+#ifdef PREFIX_TRIE_NUMA
+    // Mappings are page aligned, which satisfies any array's alignment
+    void* p = numa_alloc_onnode(bytes == 0 ? 1 : bytes, node_);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+#else
+    (void)bytes;
+    throw std::bad_alloc();
+#endif
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t) override {
+#ifdef PREFIX_TRIE_NUMA
+    numa_free(p, bytes == 0 ? 1 : bytes);
+#else
+    (void)p;
+    (void)bytes;
+#endif
+  }
+
+  bool do_is_equal(
+      const std::pmr::memory_resource& o) const noexcept override {
+    return this == &o;
+  }
+
+  int node_;
+};  // class ReplicatedFrozenTrie::NodeResource
+
+ReplicatedFrozenTrie::ReplicatedFrozenTrie(const PrefixTrie& trie,
+                                           FrozenTrie::Layout layout) {
+  // The layout is computed once and the arrays copied to every node
+  auto source = std::make_unique<FrozenTrie>(trie, layout);
+#ifdef PREFIX_TRIE_NUMA
+  if (numa_available() >= 0) {
+    std::vector<std::uint32_t> replica_of_node(numa_max_node() + 1, 0);
+    for (int node = 0; node <= numa_max_node(); ++node) {
+      if (!numa_bitmask_isbitset(numa_all_nodes_ptr, node)) continue;
+      replica_of_node[node] = static_cast<std::uint32_t>(replicas_.size());
+      resources_.push_back(std::make_unique<NodeResource>(node));
+      replicas_.push_back(
+          std::make_unique<FrozenTrie>(*source, resources_.back().get()));
+    }
+    if (!replicas_.empty()) {
+      // CPUs of memoryless nodes use the first replica
+      replica_of_cpu_.resize(numa_num_configured_cpus(), 0);
+      for (std::size_t cpu = 0; cpu < replica_of_cpu_.size(); ++cpu) {
+        const int node = numa_node_of_cpu(static_cast<int>(cpu));
+        if (node >= 0) replica_of_cpu_[cpu] = replica_of_node[node];
+      }
+      return;
+    }
+  }
+#endif
+  replicas_.push_back(std::move(source));
+}
+
+ReplicatedFrozenTrie::~ReplicatedFrozenTrie() = default;
+
+const FrozenTrie& ReplicatedFrozenTrie::Local() const noexcept {
+#ifdef __linux__
+  if (!replica_of_cpu_.empty()) {
+    const int cpu = sched_getcpu();
+    if (cpu >= 0 && static_cast<std::size_t>(cpu) < replica_of_cpu_.size())
+      return *replicas_[replica_of_cpu_[cpu]];
+  }
+#endif
+  return *replicas_[0];
+}
@@ -0,0 +1,70 @@
+#ifndef REPLICATED_FROZEN_TRIE_H__
+#define REPLICATED_FROZEN_TRIE_H__
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+#include "frozen_trie.h"
+
+class PrefixTrie;
+
+/**
+ * FrozenTrie replicated into the local memory of every NUMA node, so each
+ * lookup walks the copy on the socket the calling thread runs on instead of
+ * paying cross-node latency at every hop. Queries are routed by the CPU the
+ * thread is on at the time of the call.
+ *
+ * Replication needs libnuma at build time (the PREFIX_TRIE_NUMA CMake
+ * option) and a NUMA-capable kernel at run time; otherwise a single copy
+ * serves every thread.
+ */
+class ReplicatedFrozenTrie {
+ public:
+  explicit ReplicatedFrozenTrie(
+      const PrefixTrie& trie,
+      FrozenTrie::Layout layout = FrozenTrie::Layout::kVanEmdeBoas);
+  ~ReplicatedFrozenTrie();
+
+  ReplicatedFrozenTrie(const ReplicatedFrozenTrie& o) = delete;
+  ReplicatedFrozenTrie& operator=(const ReplicatedFrozenTrie& o) = delete;
+
+  /**
+   * Check if the local replica contains the prefix.
+   */
+  bool Contains(std::string_view s) const noexcept {
+    return Local().Contains(s);
+  }
+
+  /**
+   * Passes strings who match the given prefix into the given function callback,
+   * in lexicographic order, from the local replica.
+   */
+  template <typename Callable>
+  void MatchWithCallback(std::string_view s, const Callable& callback) const {
+    Local().MatchWithCallback(s, callback);
+  }
+
+  /**
+   * Replica for the NUMA node of the CPU the calling thread runs on.
+   */
+  const FrozenTrie& Local() const noexcept;
+
+  /**
+   * Number of copies of the trie, one per NUMA node with memory.
+   */
+  std::size_t Replicas() const noexcept { return replicas_.size(); }
+
+ private:
+  class NodeResource;
+
+  // Declared before the replicas, which allocate from them
+  std::vector<std::unique_ptr<NodeResource>> resources_;
+  std::vector<std::unique_ptr<FrozenTrie>> replicas_;
+  // Index into replicas_ by CPU; empty with a single copy
+  std::vector<std::uint32_t> replica_of_cpu_;
+};  // class ReplicatedFrozenTrie
+
+#endif  // REPLICATED_FROZEN_TRIE_H__
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+#include "sharded_prefix_trie.h"
+
+namespace {
+
+// Matches fetched from a shard per lock acquisition while merging
+constexpr std::size_t kMergePage = 256;
+
+}  // namespace
+
+ShardedPrefixTrie::ShardedPrefixTrie(std::size_t shards,
+                                     std::size_t prefix_bytes)
+    : prefix_bytes_(std::max<std::size_t>(prefix_bytes, 1)) {
+  shards_.resize(std::max<std::size_t>(shards, 1));
+  for (auto& shard : shards_) shard = std::make_unique<Shard>();
+}
+
+bool ShardedPrefixTrie::Insert(std::string_view s) {
+  auto& shard = *shards_[ShardOf(s)];
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  return shard.trie.Insert(s);
+}
+
+bool ShardedPrefixTrie::Erase(std::string_view s) {
+  auto& shard = *shards_[ShardOf(s)];
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  return shard.trie.Erase(s);
+}
+
+bool ShardedPrefixTrie::Contains(std::string_view s) const {
+  if (s.empty()) return true;
+  if (s.size() >= prefix_bytes_) {
+    const auto& shard = *shards_[ShardOf(s)];
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.trie.Contains(s);
+  }
+  for (const auto& shard : shards_) {
+    std::shared_lock<std::shared_mutex> lock(shard->mutex);
+    if (shard->trie.Contains(s)) return true;
+  }
+  return false;
+}
+
+bool ShardedPrefixTrie::ContainsKey(std::string_view s) const {
+  // Strings shorter than the shard prefix are placed by all their bytes
+  const auto& shard = *shards_[ShardOf(s)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  return shard.trie.ContainsKey(s);
+}
+
+std::size_t ShardedPrefixTrie::CountPrefix(std::string_view s) const {
+  if (s.size() >= prefix_bytes_) {
+    const auto& shard = *shards_[ShardOf(s)];
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.trie.CountPrefix(s);
+  }
+  std::size_t count = 0;
+  for (const auto& shard : shards_) {
+    std::shared_lock<std::shared_mutex> lock(shard->mutex);
+    count += shard->trie.CountPrefix(s);
+  }
+  return count;
+}
+
+std::size_t ShardedPrefixTrie::Size() const {
+  return CountPrefix("");
+}
+
+std::size_t ShardedPrefixTrie::ShardOf(std::string_view s) const noexcept {
+  return std::hash<std::string_view>()(s.substr(0, prefix_bytes_)) %
+         shards_.size();
+}
+
+bool ShardedPrefixTrie::FetchPage(std::string_view s, Page& page) const {
+  page.strings.clear();
+  page.next = 0;
+  if (page.done) return false;
+  const auto& shard = *shards_[page.shard];
+  {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    page.cursor = shard.trie.MatchFrom(
+        s, page.cursor, kMergePage,
+        [&page](const std::string& m) { page.strings.push_back(m); });
+  }
+  page.done = page.cursor.empty();
+  return !page.strings.empty();
+}
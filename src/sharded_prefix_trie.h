@@ -0,0 +1,133 @@
+#ifndef SHARDED_PREFIX_TRIE_H__
+#define SHARDED_PREFIX_TRIE_H__
+#include <cstddef>
+#include <memory>
+#include <queue>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "prefix_trie.h"
+
+/**
+ * Thread-safe prefix trie split into independently locked PrefixTrie shards.
+ * A string belongs to the shard picked by a hash of its first `prefix_bytes`
+ * bytes, so updates and lookups of different shards never contend, and write
+ * throughput scales with the number of shards.
+ *
+ * Prefix queries at least `prefix_bytes` long go to a single shard. Shorter
+ * prefixes may match strings in every shard, so they are fanned out, and
+ * MatchWithCallback merges the shards' ordered matches.
+ */
+class ShardedPrefixTrie {
+ public:
+  ShardedPrefixTrie(std::size_t shards, std::size_t prefix_bytes = 1);
+
+  ShardedPrefixTrie(const ShardedPrefixTrie& o) = delete;
+  ShardedPrefixTrie& operator=(const ShardedPrefixTrie& o) = delete;
+
+  /**
+   * Inserts the string into its shard, holding only that shard's lock.
+   * Returns false if the string was empty or already in the trie.
+   */
+  bool Insert(std::string_view s);
+
+  /**
+   * Removes the string. Returns false if it was not in the trie.
+   */
+  bool Erase(std::string_view s);
+
+  /**
+   * Check if the trie contains the prefix.
+   */
+  bool Contains(std::string_view s) const;
+
+  /**
+   * Check if the exact string was inserted, see PrefixTrie::ContainsKey.
+   */
+  bool ContainsKey(std::string_view s) const;
+
+  /**
+   * Number of strings in the trie which start with the given prefix.
+   */
+  std::size_t CountPrefix(std::string_view s) const;
+
+  /**
+   * Number of strings in the trie.
+   */
+  std::size_t Size() const;
+
+  std::size_t ShardCount() const noexcept { return shards_.size(); }
+
+  /**
+   * Passes strings who match the given prefix into the given function
+   * callback, in lexicographic order.
+   *
+   * Matches are fetched from each relevant shard in pages under its read
+   * lock and merged k-way, so the callback runs without any lock held and
+   * may update the trie. Updates made while matching may or may not be seen.
+   */
+  template <typename Callable>
+  void MatchWithCallback(std::string_view s, const Callable& callback) const {
+    std::vector<Page> pages;
+    if (s.size() >= prefix_bytes_) {
+      pages.push_back({ShardOf(s), {}, 0, {}, false});
+    } else {
+      for (std::size_t i = 0; i < shards_.size(); ++i)
+        pages.push_back({i, {}, 0, {}, false});
+    }
+
+    // Min-heap of the pages by their current string
+    auto greater = [&pages](std::size_t a, std::size_t b) {
+      return pages[a].Current() > pages[b].Current();
+    };
+    std::priority_queue<std::size_t, std::vector<std::size_t>,
+                        decltype(greater)>
+        heap(greater);
+    for (std::size_t i = 0; i < pages.size(); ++i)
+      if (FetchPage(s, pages[i])) heap.push(i);
+
+    while (!heap.empty()) {
+      const auto i = heap.top();
+      heap.pop();
+      callback(pages[i].Current());
+      if (++pages[i].next < pages[i].strings.size() || FetchPage(s, pages[i]))
+        heap.push(i);
+    }
+  }
+
+ private:
+  struct alignas(64) Shard {
+    mutable std::shared_mutex mutex;
+    PrefixTrie trie;
+  };
+
+  /**
+   * Window into one shard's ordered matches, refilled via MatchFrom.
+   */
+  struct Page {
+    std::size_t shard;
+    std::vector<std::string> strings;
+    std::size_t next;
+    // Cursor for the following page, empty once the shard is exhausted
+    std::string cursor;
+    bool done;
+
+    const std::string& Current() const noexcept { return strings[next]; }
+  };
+
+  std::size_t ShardOf(std::string_view s) const noexcept;
+
+  /**
+   * Loads the next page of matches of `s` from the page's shard. Returns
+   * false once the shard has no more matches.
+   */
+  bool FetchPage(std::string_view s, Page& page) const;
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::size_t prefix_bytes_;
+};  // class ShardedPrefixTrie
+
+#endif  // SHARDED_PREFIX_TRIE_H__
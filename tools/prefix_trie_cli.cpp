@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "frozen_trie.h"
+#include "huge_page_resource.h"
+#include "metrics.h"
+#include "prefix_trie.h"
+#include "replicated_frozen_trie.h"
+
+namespace {
+
+constexpr std::size_t kDefaultBatch = 1024;
+constexpr std::size_t kDefaultTopK = 10;
+
+int Usage() {
+  std::cerr
+      << "usage: prefix_trie_cli <command> [args]\n"
+      << "\n"
+      << "  build <keys> <trie> [threads]\n"
+      << "      Builds a trie from a newline-delimited key file ('-' for\n"
+      << "      stdin) and writes it in the serialized trie format.\n"
+      << "  query <trie> contains|count|prefix|topk [k] [batch]\n"
+      << "      Answers one query per stdin line, in batches. Prints the\n"
+      << "      query, a tab and 1/0 (contains), the number of matches\n"
+      << "      (count), every match (prefix) or the first k matches in\n"
+      << "      lexicographic order (topk, default k=10).\n"
+      << "  stats <trie> [bloom_depth] [bloom_fpr]\n"
+      << "      Prints the number of strings, nodes and key bytes, and the\n"
+      << "      size and estimated false-positive rate of a Bloom filter\n"
+      << "      over key prefixes of the given depth (default fpr=0.01).\n"
+      << "  bench <trie> contains|contains-bfs|contains-veb|contains-key|\n"
+      << "        contains-thp|contains-hugetlb|contains-numa|count|topk|\n"
+      << "        insert|insert-monotonic [queries] [k]\n"
+      << "      Times each query from the file (default: the trie's own\n"
+      << "      strings) and prints throughput and latency percentiles.\n"
+      << "      contains-bfs and contains-veb query a FrozenTrie copy in\n"
+      << "      breadth-first or van Emde Boas layout; contains-key checks\n"
+      << "      exact keys through the hashed key index. contains-thp and\n"
+      << "      contains-hugetlb query a trie on transparent or explicit\n"
+      << "      2 MB huge pages; contains-numa queries a FrozenTrie copy\n"
+      << "      replicated to every NUMA node. insert and\n"
+      << "      insert-monotonic insert each query into a new trie on the\n"
+      << "      heap or on a monotonic buffer resource. Builds with\n"
+      << "      PREFIX_TRIE_METRICS also print the trie's own metrics, and\n"
+      << "      dTLB load misses are printed where perf counters are open.\n";
+  return 1;
+}
+
+/**
+ * Counts the data TLB load misses of the calling thread in user space, where
+ * the kernel lets perf_event_open measure them.
+ */
+class TlbMissCounter {
+ public:
+  TlbMissCounter() : fd_(-1) {
+#ifdef __linux__
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+  ~TlbMissCounter() {
+#ifdef __linux__
+    if (fd_ >= 0) close(fd_);
+#endif
+  }
+
+  TlbMissCounter(const TlbMissCounter& o) = delete;
+  TlbMissCounter& operator=(const TlbMissCounter& o) = delete;
+
+  bool Available() const noexcept { return fd_ >= 0; }
+
+  void Start() noexcept {
+#ifdef __linux__
+    if (fd_ < 0) return;
+    ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  }
+
+  std::uint64_t Stop() noexcept {
+    std::uint64_t misses = 0;
+#ifdef __linux__
+    if (fd_ < 0) return 0;
+    ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd_, &misses, sizeof(misses)) != sizeof(misses)) misses = 0;
+#endif
+    return misses;
+  }
+
+ private:
+  int fd_;
+};  // class TlbMissCounter
+
+bool Load(const std::string& path, PrefixTrie& trie) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open() || !trie.Deserialize(in)) {
+    std::cerr << "prefix_trie_cli: cannot read trie " << path << "\n";
+    return false;
+  }
+  return true;
+}
+
+std::size_t ParseSize(const char* s, std::size_t fallback) {
+  if (s == nullptr) return fallback;
+  char* end;
+  const auto v = std::strtoull(s, &end, 10);
+  return *end == '\0' && v > 0 ? static_cast<std::size_t>(v) : fallback;
+}
+
+int Build(int argc, char** argv) {
+  if (argc < 4) return Usage();
+  const std::string keys = argv[2];
+  const auto threads =
+      static_cast<unsigned>(ParseSize(argc > 4 ? argv[4] : nullptr, 1));
+
+  PrefixTrie trie;
+  const bool loaded = keys == "-" ? trie.LoadFromFd(0, threads)
+                                  : trie.LoadFromFile(keys, threads);
+  if (!loaded) {
+    std::cerr << "prefix_trie_cli: cannot read keys " << keys << "\n";
+    return 1;
+  }
+  std::ofstream out(argv[3], std::ios::binary | std::ios::trunc);
+  if (!trie.Serialize(out)) {
+    std::cerr << "prefix_trie_cli: cannot write trie " << argv[3] << "\n";
+    return 1;
+  }
+  std::cerr << trie.Size() << " strings, " << trie.NodeCount() << " nodes\n";
+  return 0;
+}
+
+/**
+ * Appends the answer to a query to `out` in the format documented in Usage.
+ */
+void Answer(const PrefixTrie& trie, const std::string& mode, std::size_t k,
+            const std::string& q, std::string& out) {
+  auto line = [&out, &q](const std::string& value) {
+    out.append(q).push_back('\t');
+    out.append(value).push_back('\n');
+  };
+  if (mode == "contains") {
+    line(trie.Contains(q) ? "1" : "0");
+  } else if (mode == "count") {
+    line(std::to_string(trie.CountPrefix(q)));
+  } else {
+    const auto limit =
+        mode == "topk" ? k : std::numeric_limits<std::size_t>::max();
+    trie.MatchFrom(q, "", limit, line);
+  }
+}
+
+int Query(int argc, char** argv) {
+  if (argc < 4) return Usage();
+  const std::string mode = argv[3];
+  if (mode != "contains" && mode != "count" && mode != "prefix" &&
+      mode != "topk")
+    return Usage();
+  const auto k = ParseSize(argc > 4 ? argv[4] : nullptr, kDefaultTopK);
+  const auto batch = ParseSize(argc > 5 ? argv[5] : nullptr, kDefaultBatch);
+
+  PrefixTrie trie;
+  if (!Load(argv[2], trie)) return 1;
+
+  std::ios::sync_with_stdio(false);
+  std::vector<std::string> queries;
+  std::string q, out;
+  while (true) {
+    queries.clear();
+    while (queries.size() < batch && std::getline(std::cin, q))
+      queries.push_back(q);
+    if (queries.empty()) break;
+    for (const auto& query : queries) Answer(trie, mode, k, query, out);
+    std::cout.write(out.data(), out.size());
+    out.clear();
+  }
+  std::cout.flush();
+  return 0;
+}
+
+int Stats(int argc, char** argv) {
+  if (argc < 3) return Usage();
+  PrefixTrie trie;
+  if (!Load(argv[2], trie)) return 1;
+
+  std::size_t bytes = 0, longest = 0;
+  trie.MatchFrom("", "", std::numeric_limits<std::size_t>::max(),
+                 [&bytes, &longest](const std::string& s) {
+                   bytes += s.size();
+                   longest = std::max(longest, s.size());
+                 });
+  std::cout << "strings\t" << trie.Size() << "\n"
+            << "nodes\t" << trie.NodeCount() << "\n"
+            << "key_bytes\t" << bytes << "\n"
+            << "longest_key\t" << longest << "\n";
+  if (argc > 3) {
+    trie.EnableBloomFilter(ParseSize(argv[3], 0),
+                           argc > 4 ? std::atof(argv[4]) : 0.01);
+    const auto bloom = trie.BloomStats();
+    std::cout << "bloom_depth\t" << bloom.depth << "\n"
+              << "bloom_prefixes\t" << bloom.prefixes << "\n"
+              << "bloom_bits\t" << bloom.bits << "\n"
+              << "bloom_hashes\t" << bloom.hashes << "\n"
+              << "bloom_fpr\t" << bloom.estimated_false_positive_rate << "\n";
+  }
+  return 0;
+}
+
+int Bench(int argc, char** argv) {
+  if (argc < 4) return Usage();
+  const std::string mode = argv[3];
+  if (mode != "contains" && mode != "contains-bfs" && mode != "contains-veb" &&
+      mode != "contains-key" && mode != "count" && mode != "topk" &&
+      mode != "contains-thp" && mode != "contains-hugetlb" &&
+      mode != "contains-numa" &&
+      mode != "insert" && mode != "insert-monotonic")
+    return Usage();
+  const auto k = ParseSize(argc > 5 ? argv[5] : nullptr, kDefaultTopK);
+
+  const bool huge = mode == "contains-thp" || mode == "contains-hugetlb";
+  HugePageResource huge_pages(mode == "contains-hugetlb");
+  PrefixTrie trie(huge ? static_cast<std::pmr::memory_resource*>(&huge_pages)
+                       : std::pmr::get_default_resource());
+  if (!Load(argv[2], trie)) return 1;
+  if (mode == "contains-key") trie.EnableKeyIndex();
+  const bool frozen = mode == "contains-bfs" || mode == "contains-veb";
+  const auto frozen_trie =
+      frozen ? std::make_unique<FrozenTrie>(
+                   trie, mode == "contains-bfs"
+                             ? FrozenTrie::Layout::kBreadthFirst
+                             : FrozenTrie::Layout::kVanEmdeBoas)
+             : nullptr;
+  const bool numa = mode == "contains-numa";
+  const auto replicated =
+      numa ? std::make_unique<ReplicatedFrozenTrie>(trie) : nullptr;
+  const bool insert = mode == "insert" || mode == "insert-monotonic";
+  std::pmr::monotonic_buffer_resource arena;
+  PrefixTrie built(mode == "insert-monotonic"
+                       ? static_cast<std::pmr::memory_resource*>(&arena)
+                       : std::pmr::new_delete_resource());
+  std::vector<std::string> queries;
+  if (argc > 4) {
+    std::ifstream in(argv[4]);
+    std::string q;
+    while (std::getline(in, q)) queries.push_back(q);
+  } else {
+    trie.MatchFrom("", "", std::numeric_limits<std::size_t>::max(),
+                   [&queries](const std::string& s) { queries.push_back(s); });
+  }
+  if (queries.empty()) {
+    std::cerr << "prefix_trie_cli: no queries\n";
+    return 1;
+  }
+
+  // Only the queries themselves are of interest
+  TrieMetrics::Global().Reset();
+  using Clock = std::chrono::steady_clock;
+  std::vector<double> latencies;
+  latencies.reserve(queries.size());
+  std::size_t sink = 0;
+  TlbMissCounter tlb;
+  tlb.Start();
+  const auto start = Clock::now();
+  for (const auto& q : queries) {
+    const auto t0 = Clock::now();
+    if (frozen)
+      sink += frozen_trie->Contains(q);
+    else if (numa)
+      sink += replicated->Contains(q);
+    else if (insert)
+      built.Insert(q);
+    else if (mode == "contains" || huge)
+      sink += trie.Contains(q);
+    else if (mode == "contains-key")
+      sink += trie.ContainsKey(q);
+    else if (mode == "count")
+      sink += trie.CountPrefix(q);
+    else
+      trie.MatchFrom(q, "", k, [&sink](const std::string& s) {
+        sink += s.size();
+      });
+    latencies.push_back(
+        std::chrono::duration<double, std::nano>(Clock::now() - t0).count());
+  }
+  const std::chrono::duration<double> total = Clock::now() - start;
+  const auto tlb_misses = tlb.Stop();
+  sink += built.Size();
+
+  std::sort(latencies.begin(), latencies.end());
+  auto pct = [&latencies](double p) {
+    return latencies[static_cast<std::size_t>(p * (latencies.size() - 1))];
+  };
+  std::cout << "queries\t" << queries.size() << "\n"
+            << "qps\t" << queries.size() / total.count() << "\n"
+            << "p50_ns\t" << pct(0.5) << "\n"
+            << "p90_ns\t" << pct(0.9) << "\n"
+            << "p99_ns\t" << pct(0.99) << "\n"
+            << "max_ns\t" << latencies.back() << "\n"
+            << "checksum\t" << sink << "\n";
+  if (tlb.Available()) std::cout << "dtlb_misses\t" << tlb_misses << "\n";
+  if (numa) std::cout << "replicas\t" << replicated->Replicas() << "\n";
+  if (huge) {
+    const auto stats = huge_pages.GetStats();
+    std::cout << "hugetlb_bytes\t" << stats.explicit_bytes << "\n"
+              << "thp_bytes\t" << stats.transparent_bytes << "\n"
+              << "fallback_bytes\t" << stats.fallback_bytes << "\n";
+  }
+  if (kMetricsEnabled) std::cout << TrieMetrics::Global().ToText();
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) return Usage();
+  const std::string command = argv[1];
+  if (command == "build") return Build(argc, argv);
+  if (command == "query") return Query(argc, argv);
+  if (command == "stats") return Stats(argc, argv);
+  if (command == "bench") return Bench(argc, argv);
+  return Usage();
+}